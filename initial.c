@@ -3,10 +3,36 @@
 #include <stdbool.h>
 #include <time.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#ifdef PSYMAZE_ZLIB
+#include <zlib.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "psymaze_env.h"
 
-// Load Saved Player level from profile.txt
-int loadPlayerLevel() {
-    FILE *f = fopen("profile.txt", "r");
+#define PROFILE_FILE "profile.txt"
+
+// Load Saved Player level from profile.txt (the server keeps one file per profile)
+int loadPlayerLevel(const char *filename) {
+    FILE *f = fopen(filename, "r");
     if (!f) return 1; // default level 1 if no file yet
 
     int level = 1;
@@ -18,6 +44,68 @@ int loadPlayerLevel() {
 }
 
 
+// --- Random numbers ---
+// PCG32: 16 bytes of state, a 64-bit LCG step and an xorshift-rotate output. Each Rng is an
+// explicit object, so a thread or a batch job owns its own and nothing is shared; the stream
+// number picks the LCG increment, which gives independent sequences from the same seed.
+typedef struct {
+    uint64_t state;
+    uint64_t inc;         // stream selector, always odd
+} Rng;
+
+static inline uint32_t rngNext(Rng *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ull + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Uniform in [0, bound): Lemire's multiply-shift with a rejection step, so small dice like
+// % 3 are exactly fair and use the high bits instead of the weak low ones
+static inline uint32_t rngBelow(Rng *rng, uint32_t bound) {
+    uint64_t m = (uint64_t)rngNext(rng) * bound;
+    if ((uint32_t)m < bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while ((uint32_t)m < threshold) m = (uint64_t)rngNext(rng) * bound;
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// splitmix64 spreads nearby seeds (1, 2, 3...) into unrelated states
+uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rngSeed(Rng *rng, uint64_t seed, uint64_t stream) {
+    uint64_t mix = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    rng->inc = splitmix64(&mix) | 1u;
+    rng->state = splitmix64(&mix);
+    rngNext(rng);
+}
+
+// One stream per kind of decision, so e.g. extra mood rolls never shift the maze layout
+typedef struct {
+    Rng gen;              // maze carving and tile stitching
+    Rng obstacles;        // traps, puzzles, bonuses, power-ups
+    Rng mood;             // mood rolls
+    Rng npc;              // NPC placement
+    Rng morph;            // which cells a morph toggles
+    Rng ui;               // philosophy quotes and exercises
+} RngStreams;
+
+void rngStreamsSeed(RngStreams *s, uint64_t seed) {
+    rngSeed(&s->gen, seed, 1);
+    rngSeed(&s->obstacles, seed, 2);
+    rngSeed(&s->mood, seed, 3);
+    rngSeed(&s->npc, seed, 4);
+    rngSeed(&s->morph, seed, 5);
+    rngSeed(&s->ui, seed, 6);
+}
+
 // --- Mood logic ---
 typedef enum { SAD, NEUTRAL, HAPPY } Mood;
 const char *moodFaces[] = { ":(", ":|", ":)" };
@@ -34,6 +122,19 @@ typedef struct {
 
 typedef enum { NONE, TRAP, PUZZLE, BONUS, POWERUP } ObstacleType;
 
+// Difficulty knobs shared by the game and the simulator, which can try other values (--rules)
+typedef struct {
+    int baseDiv;          // obstacle die at level 0
+    int minTrapDiv;       // the die never gets smaller than this
+    int levelsPerDiv;     // levels per one-smaller die
+    int powerupCells;     // about one power-up per this many cells
+    int morphAmount;      // walls toggled by a morph
+    int levelUpXP;        // XP for one player level
+    int doubleLevelUpXP;  // XP for two
+} DifficultyRules;
+
+DifficultyRules rules = {18, 6, 5, 60, 3, 30, 60};
+
 typedef enum { MENTOR, SHADOW, SAGE } NPCType;
 
 typedef struct {
@@ -43,6 +144,7 @@ typedef struct {
     const char *msgNeutral;
     const char *msgSad;
     bool active;       // has this NPC already spoken?
+    int next, prev;    // chain of NPCs in the same spatial-index block
 } NPC;
 
 const char *philosophyQuotes[NUM_QUOTES] = {
@@ -80,704 +182,6517 @@ const char* obstacleNames[] = {" ", "Trap", "Puzzle", "Bonus"};
 const int DX[4] = {-1, 1, 0, 0};
 const int DY[4] = {0, 0, -1, 1};
 
-void shuffleDirections(int dirs[4]) {
+void shuffleDirections(int dirs[4], Rng *rng) {
     for (int i = 3; i > 0; i--) {
-        int j = rand() % (i + 1);
+        int j = rngBelow(rng, i + 1);
         int temp = dirs[i];
         dirs[i] = dirs[j];
         dirs[j] = temp;
     }
 }
 
-int **allocate2DIntArray(int rows, int cols) {
-    int **arr = (int **)malloc(rows * sizeof(int *));
-    for (int i = 0; i < rows; i++) {
-        arr[i] = (int *)malloc(cols * sizeof(int));
-    }
-    return arr;
-}
+// Heap calls made by the game, the benchmark build reports them per phase
+atomic_ulong allocCalls = 0;
 
-bool **allocate2DBoolArray(int rows, int cols) {
-    bool **arr = (bool **)malloc(rows * sizeof(bool *));
-    for (int i = 0; i < rows; i++) {
-        arr[i] = (bool *)calloc(cols, sizeof(bool));
-    }
-    return arr;
+void *countedMalloc(size_t size) {
+    allocCalls++;
+    return malloc(size);
 }
+void *countedCalloc(size_t count, size_t size) {
+    allocCalls++;
+    return calloc(count, size);
+}
+void *countedRealloc(void *ptr, size_t size) {
+    allocCalls++;
+    return realloc(ptr, size);
+}
+
+// --- Level arena ---
+// A campaign takes every per-level buffer from one mapping with a bump pointer. The next level
+// resets the pointer instead of freeing anything and the pages stay mapped, so a level
+// transition makes no allocator calls unless the mapping has to grow.
+#define ARENA_ALIGN 64
+
+typedef struct {
+    unsigned char *base;
+    size_t used, cap;
+    long maps;            // mappings made, growing replaces the mapping with a bigger one
+} Arena;
 
-void free2DIntArray(int **arr, int rows) {
-    for (int i = 0; i < rows; i++) free(arr[i]);
-    free(arr);
+// Empties the arena and makes sure it can hold bytes, false when out of memory
+bool arenaReset(Arena *a, size_t bytes) {
+    a->used = 0;
+    if (bytes <= a->cap) return true;
+    size_t cap = a->cap * 2 > bytes ? a->cap * 2 : bytes;
+    cap = (cap + 0xFFFFF) & ~(size_t)0xFFFFF;    // whole megabytes
+    void *base = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return false;
+    allocCalls++;
+    if (a->base) munmap(a->base, a->cap);
+    a->base = (unsigned char *)base;
+    a->cap = cap;
+    a->maps++;
+    return true;
 }
-void free2DBoolArray(bool **arr, int rows) {
-    for (int i = 0; i < rows; i++) free(arr[i]);
-    free(arr);
+
+// NULL when the arena is full; arenaReset is told the level's size up front, so it never is
+void *arenaAlloc(Arena *a, size_t size) {
+    size_t at = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (at > a->cap || size > a->cap - at) return NULL;
+    a->used = at + size;
+    return a->base + at;
 }
 
-void carveMaze(int x, int y, int **maze, bool **visited, int rows, int cols) {
-    visited[x][y] = true;
-    int dirs[4] = {0, 1, 2, 3};
-    shuffleDirections(dirs);
-    for (int i = 0; i < 4; i++) {
-        int nx = x + DX[dirs[i]] * 2;
-        int ny = y + DY[dirs[i]] * 2;
-        if (nx >= 0 && nx < rows && ny >= 0 && ny < cols && !visited[nx][ny]) {
-            maze[x + DX[dirs[i]]][y + DY[dirs[i]]] = 1;
-            maze[nx][ny] = 1;
-            carveMaze(nx, ny, maze, visited, rows, cols);
-        }
-    }
+void arenaFree(Arena *a) {
+    if (a->base) munmap(a->base, a->cap);
+    memset(a, 0, sizeof(*a));
 }
 
-//Generate maze using recursive backtracking (DFS)
-void generateMaze(int **maze, int rows, int cols, int exitX, int exitY) {
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            maze[i][j] = 0;
-    bool **visited = allocate2DBoolArray(rows, cols);
-    maze[0][0] = 1;
-    carveMaze(0, 0, maze, visited, rows, cols);
-    maze[exitX][exitY] = 1;
-    free2DBoolArray(visited, rows);
+// From the arena when there is one, otherwise from the heap
+void *levelAlloc(Arena *a, size_t size) {
+    return a ? arenaAlloc(a, size) : countedMalloc(size);
+}
+void *levelCalloc(Arena *a, size_t count, size_t size) {
+    if (!a) return countedCalloc(count, size);
+    void *p = arenaAlloc(a, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
 }
 
-// Log "life lesson" line onto journal.txt
-void logLifeLesson(const char *message) {
-    FILE *f = fopen("journal.txt", "a");
-    if (f == NULL) {
-        printf("Could not open journal file.\n");
-        return;
-    }
-    fprintf(f, "%s\n", message);
-    fclose(f);
+// --- Packed grid: one byte per cell, row-major ---
+#define CELL_OPEN      0x01   // 1 = path, 0 = wall
+#define CELL_OBS_SHIFT 1
+#define CELL_OBS_MASK  0x0E   // ObstacleType in bits 1-3
+#define CELL_VISITED   0x10   // player walked here
+#define CELL_PRESERVE  0x20   // morphs must not touch this cell
+#define CELL_SCRATCH   0x40   // temporary mark, cleared again by whoever sets it
+#define CELL_NPC       0x80   // an active NPC stands here
+
+// Ids (cells or index slots) changed since the last checkpoint, each listed once.
+// Adding is O(1) and clearing costs only the ids listed, never the whole grid.
+typedef struct {
+    int *items;
+    int count, cap;
+    uint64_t *marked;     // one bit per id, set while it is listed
+    bool overflow;        // out of memory while growing, the next checkpoint has to be a full one
+} DirtySet;
+
+bool dirtySetInit(DirtySet *d, size_t total) {
+    memset(d, 0, sizeof(*d));
+    d->marked = (uint64_t *)countedCalloc((total + 63) / 64, sizeof(uint64_t));
+    return d->marked != NULL;
 }
 
-//Place traps, puzzles, bonuses and power-ups, difficulty level can be chosen with chosenLevel
-void placeObstacles(int **maze, int **obstacles, int rows, int cols, int exitX, int exitY, int chosenLevel) {
-    int baseDiv = 18;
-    int levelFactor = chosenLevel / 5;
-    int trapDiv = baseDiv - levelFactor;
-    if(trapDiv < 6) trapDiv = 6;
+void dirtySetFree(DirtySet *d) {
+    free(d->items);
+    free(d->marked);
+    memset(d, 0, sizeof(*d));
+}
 
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (maze[i][j] == 1 && !(i == 0 && j == 0) && !(i == exitX && j == exitY)) {
-                int r = rand() % trapDiv; // You can lower for more obstacles
-                if (r == 0) obstacles[i][j] = TRAP;
-                else if (r == 1) obstacles[i][j] = PUZZLE;
-                else if (r == 2) obstacles[i][j] = BONUS;
-                else obstacles[i][j] = NONE;
-            } else {
-                obstacles[i][j] = NONE;
-            }
+static inline void dirtySetAdd(DirtySet *d, int id) {
+    uint64_t bit = 1ull << (id & 63);
+    if (d->marked[id >> 6] & bit) return;
+    if (d->count == d->cap) {
+        int cap = d->cap ? d->cap * 2 : 256;
+        int *items = (int *)countedRealloc(d->items, (size_t)cap * sizeof(int));
+        if (!items) {
+            d->overflow = true;
+            return;
         }
+        d->items = items;
+        d->cap = cap;
     }
-    int powerupCount = rows * cols / 60; // small number
-for (int k = 0; k < powerupCount; k++) {
-    int x = rand() % rows;
-    int y = rand() % cols;
-    if (maze[x][y] == 1 && obstacles[x][y] == NONE &&
-        !(x == 0 && y == 0) && !(x == exitX && y == exitY)) {
-        obstacles[x][y] = POWERUP;
-    }
+    d->marked[id >> 6] |= bit;
+    d->items[d->count++] = id;
 }
+
+void dirtySetClear(DirtySet *d) {
+    for (int k = 0; k < d->count; k++) d->marked[d->items[k] >> 6] &= ~(1ull << (d->items[k] & 63));
+    d->count = 0;
+    d->overflow = false;
 }
 
-void printMazeGeneric(int **maze, int **obstacles, int rows, int cols, int playerX, int playerY, int exitX, int exitY, bool **visited, NPC npcs[], int npcCount) {
-    for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
+// Open and visited cells per square block of the grid. The grid setters keep it current,
+// so a minimap reads one entry per block instead of rescanning the maze every frame.
+typedef struct {
+    int size;                 // cells per block side
+    int blockRows, blockCols;
+    uint32_t *open, *visited;
+    size_t cap;               // blocks the arrays hold, a smaller summary reuses them
+} BlockSummary;
 
-        bool hasNPC = false;
-        for (int k = 0; k < npcCount; k++) {
-            if (npcs[k].active && npcs[k].x == i && npcs[k].y == j) {
-                hasNPC = true;
-                break;
-            }
-        }
+typedef struct {
+    int rows, cols;
+    unsigned char *cells;
+    DirtySet *changes;        // cells whose saved bits changed, NULL unless autosaving
+    BlockSummary *summary;    // NULL unless a minimap is shown
+    uint32_t version;         // bumped when a cell opens or closes or a wall's obstacle changes
+} Grid;
 
-        if (i == playerX && j == playerY) printf("P ");
-        else if (i == exitX && j == exitY) printf("E ");
-        else if (hasNPC) printf("N ");         // show NPC
-        else if (obstacles[i][j] == TRAP) printf("T ");
-        else if (obstacles[i][j] == PUZZLE) printf("Q ");
-        else if (obstacles[i][j] == BONUS) printf("B ");
-        else if (obstacles[i][j] == POWERUP) printf("K "); // K = key/power
+bool gridInit(Grid *g, int rows, int cols) {
+    g->rows = rows;
+    g->cols = cols;
+    g->changes = NULL;
+    g->summary = NULL;
+    g->version = 0;
+    g->cells = (unsigned char *)countedCalloc((size_t)rows * cols, 1);
+    return g->cells != NULL;
+}
 
-        else if (maze[i][j] == 1) {
-            if (visited[i][j]) printf("* ");
-            else printf(". ");
-        } else {
-            printf("# ");
+void gridFree(Grid *g) {
+    free(g->cells);
+    g->cells = NULL;
+}
+
+static inline unsigned char *gridCell(const Grid *g, int x, int y) {
+    return &g->cells[(size_t)x * g->cols + y];
+}
+static inline bool gridInBounds(const Grid *g, int x, int y) {
+    return x >= 0 && x < g->rows && y >= 0 && y < g->cols;
+}
+static inline bool gridIsOpen(const Grid *g, int x, int y) {
+    return *gridCell(g, x, y) & CELL_OPEN;
+}
+static inline void gridTouch(Grid *g, size_t c) {
+    if (g->changes) dirtySetAdd(g->changes, (int)c);
+}
+static inline void gridSetOpen(Grid *g, int x, int y, bool open) {
+    gridTouch(g, (size_t)x * g->cols + y);
+    unsigned char *c = gridCell(g, x, y);
+    if (open != (bool)(*c & CELL_OPEN)) {
+        g->version++;
+        if (g->summary) {
+            BlockSummary *s = g->summary;
+            s->open[(x / s->size) * s->blockCols + y / s->size] += open ? 1 : -1;
         }
     }
-    printf("\n");
+    *c = open ? (*c | CELL_OPEN) : (*c & ~CELL_OPEN);
 }
+static inline int gridObstacle(const Grid *g, int x, int y) {
+    return (*gridCell(g, x, y) & CELL_OBS_MASK) >> CELL_OBS_SHIFT;
 }
-
-void printPlayerStatus(Player player) {
-    printf("Player Location: (%d, %d)\n", player.x, player.y);
-    printf("Current Mood: %s\n", moodFaces[player.mood]);
+static inline void gridSetObstacle(Grid *g, int x, int y, int obs) {
+    gridTouch(g, (size_t)x * g->cols + y);
+    unsigned char *c = gridCell(g, x, y);
+    if (!(*c & CELL_OPEN)) g->version++;   // jumps only care about obstacles on walls
+    *c = (*c & ~CELL_OBS_MASK) | (obs << CELL_OBS_SHIFT);
+}
+static inline bool gridHasFlag(const Grid *g, int x, int y, unsigned char flag) {
+    return *gridCell(g, x, y) & flag;
 }
-Mood generateMood() {
-    return (Mood)(rand() % 3);
+static inline void gridSetFlag(Grid *g, int x, int y, unsigned char flag) {
+    if (flag != CELL_NPC) gridTouch(g, (size_t)x * g->cols + y);
+    unsigned char *c = gridCell(g, x, y);
+    if (g->summary && (flag & CELL_VISITED) && !(*c & CELL_VISITED)) {
+        BlockSummary *s = g->summary;
+        s->visited[(x / s->size) * s->blockCols + y / s->size]++;
+    }
+    *c |= flag;
 }
 
+// Counts every block once; from then on the setters keep the counts
+bool blockSummaryBuild(BlockSummary *s, const Grid *g, int size) {
+    s->size = size;
+    s->blockRows = (g->rows + size - 1) / size;
+    s->blockCols = (g->cols + size - 1) / size;
+    size_t blocks = (size_t)s->blockRows * s->blockCols;
+    if (blocks > s->cap) {
+        free(s->open);
+        free(s->visited);
+        s->open = (uint32_t *)countedCalloc(blocks, sizeof(uint32_t));
+        s->visited = (uint32_t *)countedCalloc(blocks, sizeof(uint32_t));
+        s->cap = s->open && s->visited ? blocks : 0;
+        if (!s->cap) return false;
+    } else {
+        memset(s->open, 0, blocks * sizeof(uint32_t));
+        memset(s->visited, 0, blocks * sizeof(uint32_t));
+    }
+    for (int x = 0; x < g->rows; x++) {
+        const unsigned char *row = g->cells + (size_t)x * g->cols;
+        uint32_t *open = s->open + (size_t)(x / size) * s->blockCols;
+        uint32_t *visited = s->visited + (size_t)(x / size) * s->blockCols;
+        for (int y = 0; y < g->cols; y++) {
+            open[y / size] += row[y] & CELL_OPEN;
+            visited[y / size] += (row[y] & CELL_VISITED) != 0;
+        }
+    }
+    return true;
+}
 
-void processObstacle(Player *player, int obs,
-                     int *trapCount, int *puzzleCount, int *bonusCount, int rows, int cols) {
-    if (obs == TRAP) {
-        (*trapCount)++;  // count traps
+void blockSummaryFree(BlockSummary *s) {
+    free(s->open);
+    free(s->visited);
+    memset(s, 0, sizeof(*s));
+}
 
-        if (player->mood != HAPPY) {
-            printf("You hit a trap! Only Happy players can pass. You lose a turn. Try to cheer up!\n");
-            logLifeLesson("You hit a trap while not happy: sometimes you need inner strength before facing certain challenges.");
-            player->mood = SAD;
-        } else {
-            printf("You happily avoided the trap!\n");
-            logLifeLesson("You avoided a trap while happy: good moods can help you navigate problems more lightly.");
-        }
+// --- Open/closed cell index ---
+// cells[] holds every cell id (x * cols + y): open ones in [0, openCount), walls after that.
+// pos[] maps a cell id back to its slot, so toggling a cell is one swap across the boundary
+// and a uniformly random open (or closed) cell is a single draw.
+typedef struct {
+    int *cells;
+    int *pos;
+    int openCount;
+    int total;
+    DirtySet *changes;    // slots that changed, NULL unless autosaving
+} CellIndex;
 
-    } else if (obs == PUZZLE) {
-        (*puzzleCount)++;  // count puzzles
+bool cellIndexBuild(CellIndex *idx, const Grid *g) {
+    int total = g->rows * g->cols;
+    if (!idx->cells || idx->total != total) {
+        free(idx->cells);
+        free(idx->pos);
+        idx->cells = (int *)countedMalloc((size_t)total * sizeof(int));
+        idx->pos = (int *)countedMalloc((size_t)total * sizeof(int));
+        if (!idx->cells || !idx->pos) return false;
+    }
+    idx->total = total;
+    int open = 0, closed = total;
+    for (int c = 0; c < total; c++) {
+        int slot = (g->cells[c] & CELL_OPEN) ? open++ : --closed;
+        idx->cells[slot] = c;
+        idx->pos[c] = slot;
+    }
+    idx->openCount = open;
+    return true;
+}
 
-        printf("You found a puzzle! It alters your mood.\n");
-        logLifeLesson("You faced a puzzle: complex situations can shift how you feel and think.");
-        player->mood = (player->mood + 1) % 3;
+void cellIndexFree(CellIndex *idx) {
+    free(idx->cells);
+    free(idx->pos);
+    idx->cells = idx->pos = NULL;
+}
 
-    } else if (obs == POWERUP) {
-    printf("You found a power-up tile!\n");
+static inline void cellIndexSwap(CellIndex *idx, int slotA, int slotB) {
+    if (idx->changes) {
+        dirtySetAdd(idx->changes, slotA);
+        dirtySetAdd(idx->changes, slotB);
+    }
+    int a = idx->cells[slotA], b = idx->cells[slotB];
+    idx->cells[slotA] = b;
+    idx->cells[slotB] = a;
+    idx->pos[b] = slotA;
+    idx->pos[a] = slotB;
+}
 
-    if (player->mood == HAPPY) {
-        printf("Your joy unlocks a shortcut somewhere in the maze.\n");
-        logLifeLesson("Happiness unlocked new paths: positive states can reveal hidden options.");
-    } else if (player->mood == SAD) {
-        printf("In sadness, the maze feels heavier.\n");
-        logLifeLesson("Sadness closed some paths: sometimes our mood narrows our vision.");
+// Open or close a cell, keeping the grid and the index in step
+void cellIndexSetOpen(CellIndex *idx, Grid *g, int x, int y, bool open) {
+    if (gridIsOpen(g, x, y) == open) return;
+    int c = x * g->cols + y;
+    if (open) {
+        cellIndexSwap(idx, idx->pos[c], idx->openCount);
+        idx->openCount++;
     } else {
-        printf("Neutral mind, neutral maze: nothing changes, yet.\n");
-        logLifeLesson("Neutrality kept the maze steady: not every moment needs change.");
+        idx->openCount--;
+        cellIndexSwap(idx, idx->pos[c], idx->openCount);
     }
-} else if (obs == BONUS) {
-        (*bonusCount)++;  // count bonuses
+    gridSetOpen(g, x, y, open);
+}
 
-        printf("You found a bonus! Your mood is now Happy!\n");
-        logLifeLesson("You found a bonus: good surprises can flip a bad day into a brighter one.");
-        player->mood = HAPPY;
-    }
-    
+// Random open / closed cell id, -1 when there is none
+int cellIndexRandomOpen(const CellIndex *idx, Rng *rng) {
+    return idx->openCount > 0 ? idx->cells[rngBelow(rng, idx->openCount)] : -1;
+}
+int cellIndexRandomClosed(const CellIndex *idx, Rng *rng) {
+    int closed = idx->total - idx->openCount;
+    return closed > 0 ? idx->cells[idx->openCount + rngBelow(rng, closed)] : -1;
 }
 
-// Randomly show either a philosophical quote or a small exercise
-void showRandomPhilosophySupport() {
-    int r = rand() % 2; // 0 quote, 1 exercise
-    if (r == 0) {
-        int idx = rand() % NUM_QUOTES;
-        printf("\n--- Philosophical Quote ---\n");
-        printf("%s\n", philosophyQuotes[idx]);
-        printf("----------------------------\n");
-    } else {
-        int idx = rand() % NUM_EXERCISES;
-        printf("\n--- Philosophical Exercise ---\n");
-        printf("%s\n", philosophyExercises[idx]);
-        printf("\nDo you want to answer this? (y/n): ");
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF) {} // clear leftover
-        char choice = getchar();
-        if (choice == 'y' || choice == 'Y') {
-            char answer[256];
-            while ((c = getchar()) != '\n' && c != EOF) {} // clear line
-            printf("Your reflection: ");
-            if (fgets(answer, sizeof(answer), stdin)) {
-                // simple response
-                printf("\nThanks for sharing. Even small reflections can change how you move in the maze and in life.\n");
-                logLifeLesson("Player completed a philosophical exercise and reflected on their journey.");
-            }
-        } else {
-            printf("That's okay. Not every question needs an answer right now.\n");
+// --- Reachability keeper ---
+// dist[] is the BFS distance of every cell to the exit (REACH_INF when cut off), kept up to
+// date one toggle at a time: opening a cell can only lower distances, so a BFS from that cell
+// fixes them; closing one raises the distances of the cells that routed through it, so only
+// those are reset and re-derived from their neighbours. Neither touches the rest of the grid.
+// CELL_PRESERVE marks one live shortest route from the player to the exit, morphs never touch
+// those cells, so closing a wall elsewhere cannot cut the player off.
+#define REACH_INF 0x7FFFFFFF
+
+typedef struct {
+    int *dist;
+    int *queue;           // scratch for BFS and the affected set
+    long long *order;     // scratch: affected cells sorted by new distance
+    int *route;           // cells of the protected route, route[routeHead] is the player
+    int routeHead, routeEnd;
+    long rebuilds;        // times the route was marked from scratch
+    int exitCell;
+    int total;
+} Reach;
+
+static inline int reachNeighbour(const Grid *g, int c, int d) {
+    int x = c / g->cols + DX[d], y = c % g->cols + DY[d];
+    return gridInBounds(g, x, y) ? x * g->cols + y : -1;
+}
+
+// Full BFS from the exit, only needed once per level
+// Allocates the field and its scratch without filling it in
+bool reachAlloc(Reach *r, const Grid *g, int exitX, int exitY, Arena *arena) {
+    int total = g->rows * g->cols;
+    memset(r, 0, sizeof(*r));
+    r->total = total;
+    r->exitCell = exitX * g->cols + exitY;
+    r->dist = (int *)levelAlloc(arena, (size_t)total * sizeof(int));
+    r->queue = (int *)levelAlloc(arena, (size_t)total * sizeof(int));
+    r->order = (long long *)levelAlloc(arena, (size_t)total * sizeof(long long));
+    r->route = (int *)levelAlloc(arena, (size_t)total * sizeof(int));
+    return r->dist && r->queue && r->order && r->route;
+}
+
+// Recomputes every distance with one BFS from the exit, the route is left alone
+void reachFill(Reach *r, const Grid *g) {
+    int total = r->total;
+    for (int c = 0; c < total; c++) r->dist[c] = REACH_INF;
+    if (!(g->cells[r->exitCell] & CELL_OPEN)) return;
+    int head = 0, tail = 0;
+    r->dist[r->exitCell] = 0;
+    r->queue[tail++] = r->exitCell;
+    while (head < tail) {
+        int u = r->queue[head++];
+        for (int d = 0; d < 4; d++) {
+            int v = reachNeighbour(g, u, d);
+            if (v < 0 || !(g->cells[v] & CELL_OPEN) || r->dist[v] != REACH_INF) continue;
+            r->dist[v] = r->dist[u] + 1;
+            r->queue[tail++] = v;
         }
-        printf("----------------------------\n");
     }
 }
 
-//Maze wall is changed based on player's mood
-void morphMaze(int **maze, int **obstacles, int rows, int cols,
-               int morphAmount, bool **preservePath, Player player) {
-    for (int n = 0; n < morphAmount; n++) {
-        int i = rand() % rows;
-        int j = rand() % cols;
+bool reachBuild(Reach *r, const Grid *g, int exitX, int exitY, Arena *arena) {
+    if (!reachAlloc(r, g, exitX, exitY, arena)) return false;
+    reachFill(r, g);
+    return true;
+}
 
-        if (preservePath[i][j]) continue;               // not to touch protected cells
-        if (player.x == i && player.y == j) continue;   // not to trap player
+void reachFree(Reach *r) {
+    free(r->dist);
+    free(r->queue);
+    free(r->order);
+    free(r->route);
+    r->dist = r->queue = r->route = NULL;
+    r->order = NULL;
+}
 
-        // Mood-based rule:
-        // SAD  -> more openings
-        // HAPPY-> more walls (slightly harder)
-        // NEUTRAL -> random toggle
-        if (maze[i][j] == 0 && player.mood == SAD) {
-            maze[i][j] = 1;      // open a wall
-        } else if (maze[i][j] == 1 && player.mood == HAPPY) {
-            maze[i][j] = 0;      // to close a path
-        } else {
-            maze[i][j] = (maze[i][j] == 1) ? 0 : 1; // neutral: toggle
-        }
+// Distances only shrink: relax outwards from the newly opened cell
+void reachOnOpen(Reach *r, const Grid *g, int c) {
+    int best = REACH_INF;
+    for (int d = 0; d < 4; d++) {
+        int v = reachNeighbour(g, c, d);
+        if (v >= 0 && (g->cells[v] & CELL_OPEN) && r->dist[v] < best) best = r->dist[v];
     }
+    r->dist[c] = c == r->exitCell ? 0 : (best == REACH_INF ? REACH_INF : best + 1);
+    if (r->dist[c] == REACH_INF) return;
 
-    // Move one random obstacle
-    int oi = rand() % rows;
-    int oj = rand() % cols;
-    if (!preservePath[oi][oj] && maze[oi][oj] == 1 &&
-        !(player.x == oi && player.y == oj)) {
-        obstacles[oi][oj] = rand() % 3 + 1; // TRAP, PUZZLE, BONUS
+    int head = 0, tail = 0;
+    r->queue[tail++] = c;
+    while (head < tail) {
+        int u = r->queue[head++];
+        for (int d = 0; d < 4; d++) {
+            int v = reachNeighbour(g, u, d);
+            if (v < 0 || !(g->cells[v] & CELL_OPEN) || r->dist[v] <= r->dist[u] + 1) continue;
+            r->dist[v] = r->dist[u] + 1;
+            r->queue[tail++] = v;
+        }
     }
 }
 
-void initNPCs(NPC npcs[], int npcCount, int rows, int cols, int **maze) {
-    // positions picked randomly on paths
-    for (int i = 0; i < npcCount; i++) {
-        npcs[i].type = (i == 0) ? MENTOR : (i == 1) ? SHADOW : SAGE;
-        npcs[i].active = true;
+int compareLongLong(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
 
-        // to place on a random path tile
-        while (1) {
-            int rx = rand() % rows;
-            int ry = rand() % cols;
-            if (maze[rx][ry] == 1 && !(rx == 0 && ry == 0)) {
-                npcs[i].x = rx;
-                npcs[i].y = ry;
-                break;
+// Distances only grow, and only for cells whose every shortest way out ran through c.
+// Level by level, a cell is affected when no unaffected neighbour sits one step closer;
+// affected cells are then re-derived from the unaffected border in distance order
+// (sorted seeds merged with a FIFO, which is Dijkstra for unit steps).
+void reachOnClose(Reach *r, Grid *g, int c) {
+    int oldDist = r->dist[c];
+    r->dist[c] = REACH_INF;
+    if (oldDist == REACH_INF) return;
+
+    int head = 0, tail = 0, affected = 0;
+    for (int d = 0; d < 4; d++) {
+        int v = reachNeighbour(g, c, d);
+        if (v >= 0 && (g->cells[v] & CELL_OPEN) && r->dist[v] == oldDist + 1) r->queue[tail++] = v;
+    }
+    while (head < tail) {
+        int v = r->queue[head++];
+        if (g->cells[v] & CELL_SCRATCH) continue;
+        bool supported = false;
+        for (int d = 0; d < 4 && !supported; d++) {
+            int u = reachNeighbour(g, v, d);
+            supported = u >= 0 && (g->cells[u] & CELL_OPEN) && !(g->cells[u] & CELL_SCRATCH)
+                        && r->dist[u] == r->dist[v] - 1;
+        }
+        if (supported) continue;
+        g->cells[v] |= CELL_SCRATCH;
+        r->order[affected++] = v;
+        for (int d = 0; d < 4; d++) {
+            int w = reachNeighbour(g, v, d);
+            if (w < 0 || !(g->cells[w] & CELL_OPEN) || r->dist[w] != r->dist[v] + 1) continue;
+            // only the first affected parent queues w, which keeps the queue within total
+            bool queued = false;
+            for (int e = 0; e < 4 && !queued; e++) {
+                int u = reachNeighbour(g, w, e);
+                queued = u >= 0 && u != v && (g->cells[u] & CELL_SCRATCH) && r->dist[u] == r->dist[v];
             }
+            if (!queued) r->queue[tail++] = w;
         }
+    }
+    if (affected == 0) return;
 
-        // messages by type
-        if (npcs[i].type == MENTOR) {
-            npcs[i].msgHappy   = "Mentor: You’re glowing today. Use this energy wisely.";
-            npcs[i].msgNeutral = "Mentor: Even small steps count. Keep going.";
-            npcs[i].msgSad     = "Mentor: It’s okay to move slowly. Just don’t stop.";
-        } else if (npcs[i].type == SHADOW) {
-            npcs[i].msgHappy   = "Shadow: Are you sure this happiness isn’t just a mask?";
-            npcs[i].msgNeutral = "Shadow: Silence is loud, isn’t it?";
-            npcs[i].msgSad     = "Shadow: I know the dark corners. But they’re not all you are.";
-        } else { // SAGE
-            npcs[i].msgHappy   = "Sage: Joy is also data. Notice what makes it arise.";
-            npcs[i].msgNeutral = "Sage: Observe your mind like a sky, not the clouds.";
-            npcs[i].msgSad     = "Sage: Pain is a teacher. What is it asking you to see?";
+    // tentative distance through the best unaffected neighbour, sort key = distance << 32 | cell
+    for (int k = 0; k < affected; k++) {
+        int v = (int)r->order[k];
+        int best = REACH_INF;
+        for (int d = 0; d < 4; d++) {
+            int u = reachNeighbour(g, v, d);
+            if (u >= 0 && (g->cells[u] & CELL_OPEN) && !(g->cells[u] & CELL_SCRATCH) && r->dist[u] < best) best = r->dist[u];
         }
+        r->dist[v] = best == REACH_INF ? REACH_INF : best + 1;
+        r->order[k] = (long long)r->dist[v] << 32 | v;
     }
-}
-
-// NPC talks based on mood and stats, later, asks for reflection line
-void speakWithNPC(NPC *npc, Player *player,
-                  int steps,
-                  int trapCount, int puzzleCount, int philosophyUses);
-
-//Check if player is on an NPC tile and trigger the encounter once
-void checkNPCEncounter(Player *player, NPC npcs[], int npcCount, int steps, int trapCount, int puzzleCount, int philosophyUses) {
-    for (int i = 0; i < npcCount; i++) {
-        if (!npcs[i].active) continue;
-        if (npcs[i].x == player->x && npcs[i].y == player->y) {
+    qsort(r->order, affected, sizeof(long long), compareLongLong);
 
-            speakWithNPC(&npcs[i], player, steps, trapCount, puzzleCount, philosophyUses);
-            logLifeLesson("You met an archetype in the maze: guidance appears in many forms when you keep moving.");
-            npcs[i].active = false;
+    // settled cells lose CELL_SCRATCH, whatever is still marked at the end is cut off
+    head = tail = 0;
+    int next = 0;
+    while (true) {
+        bool seedLeft = next < affected && (int)(r->order[next] >> 32) != REACH_INF;
+        int v;
+        if (head < tail && (!seedLeft || r->dist[r->queue[head]] <= (int)(r->order[next] >> 32))) {
+            v = r->queue[head++];
+        } else if (seedLeft) {
+            v = (int)(r->order[next++] & 0xFFFFFFFF);
+            if (!(g->cells[v] & CELL_SCRATCH)) continue;   // already settled closer
+            g->cells[v] &= ~CELL_SCRATCH;
+        } else {
+            break;
+        }
+        for (int d = 0; d < 4; d++) {
+            int w = reachNeighbour(g, v, d);
+            if (w < 0 || !(g->cells[w] & CELL_SCRATCH) || r->dist[w] <= r->dist[v] + 1) continue;
+            r->dist[w] = r->dist[v] + 1;
+            g->cells[w] &= ~CELL_SCRATCH;
+            r->queue[tail++] = w;
         }
     }
+    for (int k = 0; k < affected; k++) g->cells[r->order[k] & 0xFFFFFFFF] &= ~CELL_SCRATCH;
 }
 
-
-void showJournal() {
-    FILE *f = fopen("journal.txt", "r");
-    if (f == NULL) {
-        printf("\nNo journal entries yet. Go live a little in the maze first.\n");
+// Re-mark the protected route when the player left it or a shortcut opened.
+// Stepping along the route just drops the cell behind, so a normal move costs O(1).
+void reachUpdateRoute(Reach *r, Grid *g, int playerX, int playerY) {
+    int p = playerX * g->cols + playerY;
+    int len = r->routeEnd - r->routeHead;
+    if (len >= 2 && r->route[r->routeHead + 1] == p && r->dist[p] == len - 2) {
+        gridTouch(g, r->route[r->routeHead]);
+        g->cells[r->route[r->routeHead++]] &= ~CELL_PRESERVE;
         return;
     }
+    if (len >= 1 && r->route[r->routeHead] == p && r->dist[p] == len - 1) return;
 
-    char buffer[MAX_LINE_LEN];
-    printf("\n===== Life Lessons Journal =====\n");
-    while (fgets(buffer, MAX_LINE_LEN, f)) {
-        // remove newline
-        buffer[strcspn(buffer, "\n")] = 0;
-        printf("- %s\n", buffer);
+    for (int k = r->routeHead; k < r->routeEnd; k++) {
+        gridTouch(g, r->route[k]);
+        g->cells[r->route[k]] &= ~CELL_PRESERVE;
+    }
+    r->routeHead = r->routeEnd = 0;
+    r->rebuilds++;
+    if (r->dist[p] == REACH_INF) return;   // jumped into a pocket that has no way out
+    for (int u = p; ; ) {
+        gridTouch(g, u);
+        g->cells[u] |= CELL_PRESERVE;
+        r->route[r->routeEnd++] = u;
+        if (r->dist[u] == 0) break;
+        for (int d = 0; d < 4; d++) {
+            int v = reachNeighbour(g, u, d);
+            if (v >= 0 && (g->cells[v] & CELL_OPEN) && r->dist[v] == r->dist[u] - 1) { u = v; break; }
+        }
     }
-    printf("================================\n\n");
-    fclose(f);
 }
 
-// Generate maze based on chosen level (size grows with level)
-// Place mood-based NPC archetypes
-// Handle traps/puzzles/bonuses and log "life lessons"
-
-int levelToSize(int level) {
-    if (level < 1) level = 1;
-    if (level > 50) level = 50;        // levels 1–50
+// --- Bit-parallel BFS ---
+// Built into the bench only: its distance BFS loses to the queue BFS it was measured against,
+// and the game's reachability already comes from the incremental distance field above.
+#ifdef PSYMAZE_BENCH
+// The maze as one bit per cell, 64 cells per word, so a BFS level expands whole words at a
+// time: next = (front << 1 | front >> 1 | row above | row below) & open & ~seen.
+// Every row has a zero guard word on each side and there is a zero guard row above and
+// below, so the shifts and the vertical neighbours never need a bounds check.
+// Only rows with a live frontier (and their neighbours) are touched on each level, and
+// only over the span of words that can change, so long thin corridors cost about as much
+// as a queue BFS and open areas expand 64 cells per operation (256 with AVX2).
+typedef struct {
+    int rows, cols;
+    int words;                    // words per row, without the guards
+    int stride;                   // words + 2 guards
+    uint64_t *open, *seen, *front, *next;
+    int *lists;                   // one block behind the nine per-row lists below
+    int *active, *nextActive;     // rows with a non-empty frontier
+    int *lo, *hi, *nextLo, *nextHi; // span of frontier words in each active row
+    int *candLo, *candHi, *stamp; // rows to expand on this level and their word spans
+    int levels;                   // BFS depth reached by the last run
+    long reached;                 // cells reached by the last run
+} BitBfs;
 
-    int size = 9 + level * 2;         
-    return size;
+static inline uint64_t *bitBfsRow(const BitBfs *b, uint64_t *plane, int x) {
+    return plane + (size_t)(x + 1) * b->stride + 1;
 }
 
+void bitBfsFree(BitBfs *b) {
+    free(b->open);
+    free(b->seen);
+    free(b->front);
+    free(b->next);
+    free(b->lists);
+    *b = (BitBfs){0};
+}
 
-
-
-
-void saveRunSnapshot(const char *filename,
-                     int **maze, int **obstacles,
-                     int rows, int cols,
-                     Player player, int exitX, int exitY) {
-    FILE *f = fopen(filename, "w");
-    if (!f) {
-        printf("Could not open snapshot file.\n");
-        return;
+bool bitBfsInit(BitBfs *b, int rows, int cols) {
+    *b = (BitBfs){0};
+    b->rows = rows;
+    b->cols = cols;
+    b->words = (cols + 63) / 64;
+    b->stride = b->words + 2;
+    size_t planeWords = (size_t)(rows + 2) * b->stride;
+    b->open = (uint64_t *)countedCalloc(planeWords, sizeof(uint64_t));
+    b->seen = (uint64_t *)countedCalloc(planeWords, sizeof(uint64_t));
+    b->front = (uint64_t *)countedCalloc(planeWords, sizeof(uint64_t));
+    b->next = (uint64_t *)countedCalloc(planeWords, sizeof(uint64_t));
+    b->lists = (int *)countedMalloc((size_t)rows * 9 * sizeof(int));
+    if (!b->open || !b->seen || !b->front || !b->next || !b->lists) {
+        bitBfsFree(b);
+        return false;
     }
+    b->active = b->lists;
+    b->nextActive = b->lists + rows;
+    b->lo = b->lists + 2 * rows;
+    b->hi = b->lists + 3 * rows;
+    b->nextLo = b->lists + 4 * rows;
+    b->nextHi = b->lists + 5 * rows;
+    b->candLo = b->lists + 6 * rows;
+    b->candHi = b->lists + 7 * rows;
+    b->stamp = b->lists + 8 * rows;
+    return true;
+}
 
-    // Header info
-    fprintf(f, "PsyMaze Snapshot\n");
-    fprintf(f, "Size: %d x %d\n", rows, cols);
-    fprintf(f, "Player: (%d,%d) Mood: %s\n", player.x, player.y, moodFaces[player.mood]);
-    fprintf(f, "Exit: (%d,%d)\n", exitX, exitY);
-    fprintf(f, "Maze:\n");
-
-    // Maze + obstacles
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (i == player.x && j == player.y)      fputc('P', f);
-            else if (i == exitX && j == exitY)       fputc('E', f);
-            else if (obstacles[i][j] == TRAP)        fputc('T', f);
-            else if (obstacles[i][j] == PUZZLE)      fputc('Q', f);
-            else if (obstacles[i][j] == BONUS)       fputc('B', f);
-            else if (maze[i][j] == 1)                fputc('.', f);
-            else                                     fputc('#', f);
+// Packs CELL_OPEN of every cell into the open plane, call again after the maze changes
+void bitBfsLoad(BitBfs *b, const Grid *g) {
+    for (int x = 0; x < b->rows; x++) {
+        const unsigned char *cells = g->cells + (size_t)x * g->cols;
+        uint64_t *row = bitBfsRow(b, b->open, x);
+        int y = 0;
+#ifdef __SSE2__
+        // shifting each byte's open bit up to its sign bit lets movemask take 16 cells at once
+        for (; y + 16 <= b->cols; y += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(cells + y));
+            uint64_t bits = (uint16_t)_mm_movemask_epi8(_mm_slli_epi16(v, 7));
+            if ((y & 63) == 0) row[y >> 6] = 0;
+            row[y >> 6] |= bits << (y & 63);
+        }
+#endif
+        for (; y < b->cols; y++) {
+            if ((y & 63) == 0) row[y >> 6] = 0;
+            row[y >> 6] |= (uint64_t)(cells[y] & CELL_OPEN) << (y & 63);
         }
-        fputc('\n', f);
     }
+}
 
-    fclose(f);
-    printf("Run snapshot saved to %s\n", filename);
+// One level for one row over words [lo, hi]: writes next, marks it seen, returns the OR of next
+static inline uint64_t bitBfsStepRow(const uint64_t *up, const uint64_t *front, const uint64_t *down,
+                                     const uint64_t *open, uint64_t *seen, uint64_t *next, int lo, int hi) {
+    uint64_t any = 0;
+    int i = lo;
+#ifdef __AVX2__
+    __m256i anyV = _mm256_setzero_si256();
+    for (; i + 4 <= hi + 1; i += 4) {
+        __m256i f = _mm256_loadu_si256((const __m256i *)(front + i));
+        __m256i fPrev = _mm256_loadu_si256((const __m256i *)(front + i - 1));
+        __m256i fNext = _mm256_loadu_si256((const __m256i *)(front + i + 1));
+        __m256i grow = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi64(f, 1), _mm256_srli_epi64(fPrev, 63)),
+            _mm256_or_si256(_mm256_srli_epi64(f, 1), _mm256_slli_epi64(fNext, 63)));
+        grow = _mm256_or_si256(grow, _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(up + i)),
+                                                     _mm256_loadu_si256((const __m256i *)(down + i))));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(seen + i));
+        __m256i n = _mm256_andnot_si256(s, _mm256_and_si256(grow, _mm256_loadu_si256((const __m256i *)(open + i))));
+        _mm256_storeu_si256((__m256i *)(next + i), n);
+        _mm256_storeu_si256((__m256i *)(seen + i), _mm256_or_si256(s, n));
+        anyV = _mm256_or_si256(anyV, n);
+    }
+    any = !_mm256_testz_si256(anyV, anyV);
+#endif
+    for (; i <= hi; i++) {
+        uint64_t grow = front[i] << 1 | front[i - 1] >> 63 | front[i] >> 1 | front[i + 1] << 63 | up[i] | down[i];
+        uint64_t n = grow & open[i] & ~seen[i];
+        next[i] = n;
+        seen[i] |= n;
+        any |= n;
+    }
+    return any;
 }
 
-void speakWithNPC(NPC *npc, Player *player,
-                  int steps,
-                  int trapCount, int puzzleCount, int philosophyUses) {
-    const char *baseMsg = NULL;
-    if (player->mood == HAPPY)      baseMsg = npc->msgHappy;
-    else if (player->mood == NEUTRAL) baseMsg = npc->msgNeutral;
-    else                             baseMsg = npc->msgSad;
+// Floods from (fromX, fromY) over the loaded open plane. dist (rows * cols, may be NULL)
+// receives the BFS distance of every cell, REACH_INF where unreachable; the seen plane is
+// the reachability mask afterwards. Returns the number of cells reached.
+long bitBfsRun(BitBfs *b, int fromX, int fromY, int *dist) {
+    int rows = b->rows, cols = b->cols;
+    size_t planeWords = (size_t)(rows + 2) * b->stride;
+    memset(b->seen, 0, planeWords * sizeof(uint64_t));
+    memset(b->stamp, 0, (size_t)rows * sizeof(int));   // levels count from 1
+    if (dist) {
+        for (size_t c = 0; c < (size_t)rows * cols; c++) dist[c] = REACH_INF;
+    }
+    b->levels = 0;
+    b->reached = 0;
+    uint64_t bit = (uint64_t)1 << (fromY & 63);
+    if (!(bitBfsRow(b, b->open, fromX)[fromY >> 6] & bit)) return 0;
 
-    printf("\n--- NPC Encounter ---\n");
+    bitBfsRow(b, b->front, fromX)[fromY >> 6] = bit;
+    bitBfsRow(b, b->seen, fromX)[fromY >> 6] = bit;
+    if (dist) dist[(size_t)fromX * cols + fromY] = 0;
+    b->reached = 1;
+    int activeCount = 1;
+    b->active[0] = fromX;
+    b->lo[fromX] = b->hi[fromX] = fromY >> 6;
 
-    // Base line depending on archetype & mood
-    printf("%s\n", baseMsg);
+    for (int level = 1; activeCount > 0; level++) {
+        // rows next to a live frontier, with the words their frontier can reach
+        int candCount = 0;
+        for (int k = 0; k < activeCount; k++) {
+            int x = b->active[k];
+            int lo = b->lo[x] > 0 ? b->lo[x] - 1 : 0;
+            int hi = b->hi[x] < b->words - 1 ? b->hi[x] + 1 : b->words - 1;
+            for (int nx = x - 1; nx <= x + 1; nx++) {
+                if (nx < 0 || nx >= rows) continue;
+                if (b->stamp[nx] != level) {
+                    b->stamp[nx] = level;
+                    b->candLo[nx] = lo;
+                    b->candHi[nx] = hi;
+                    b->nextActive[candCount++] = nx;
+                } else {
+                    if (lo < b->candLo[nx]) b->candLo[nx] = lo;
+                    if (hi > b->candHi[nx]) b->candHi[nx] = hi;
+                }
+            }
+        }
 
-    // comments based on stats
-    if (steps > 150) {
-        printf("NPC: You've been wandering a long time... what keeps you going?\n");
-    }
-    if (trapCount > 0) {
-        printf("NPC: I see you've survived some traps. What did they teach you?\n");
-    }
-    if (philosophyUses >= 3) {
-        printf("NPC: You seek wisdom often. That curiosity is your true power.\n");
-    }
+        int nextCount = 0;
+        for (int k = 0; k < candCount; k++) {
+            int x = b->nextActive[k];
+            int lo = b->candLo[x], hi = b->candHi[x];
+            uint64_t *next = bitBfsRow(b, b->next, x);
+            if (!bitBfsStepRow(bitBfsRow(b, b->front, x - 1), bitBfsRow(b, b->front, x),
+                               bitBfsRow(b, b->front, x + 1), bitBfsRow(b, b->open, x),
+                               bitBfsRow(b, b->seen, x), next, lo, hi)) continue;
+            while (next[lo] == 0) lo++;
+            while (next[hi] == 0) hi--;
+            b->nextLo[x] = lo;
+            b->nextHi[x] = hi;
+            // nextCount never passes k, so the candidate list is compacted in place
+            b->nextActive[nextCount++] = x;
+            for (int i = lo; i <= hi; i++) {
+                uint64_t w = next[i];
+                while (w) {
+                    if (dist) dist[(size_t)x * cols + i * 64 + __builtin_ctzll(w)] = level;
+                    b->reached++;
+                    w &= w - 1;
+                }
+            }
+        }
 
-    printf("NPC: Before you go, answer this in one line:\n");
-    printf("     What is one thing you learned in this maze so far?\n");
+        // the old frontier becomes the zeroed buffer for the level after this one
+        for (int k = 0; k < activeCount; k++) {
+            int x = b->active[k];
+            memset(bitBfsRow(b, b->front, x) + b->lo[x], 0, (size_t)(b->hi[x] - b->lo[x] + 1) * sizeof(uint64_t));
+        }
+        uint64_t *plane = b->front;
+        b->front = b->next;
+        b->next = plane;
+        int *list = b->active;
+        b->active = b->nextActive;
+        b->nextActive = list;
+        int *span = b->lo;
+        b->lo = b->nextLo;
+        b->nextLo = span;
+        span = b->hi;
+        b->hi = b->nextHi;
+        b->nextHi = span;
+        activeCount = nextCount;
+        if (nextCount > 0) b->levels = level;
+    }
+    return b->reached;
+}
 
-    char answer[256];
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF) {} // clear leftover
-    printf("Your reflection: ");
-    if (fgets(answer, sizeof(answer), stdin)) {
-        answer[strcspn(answer, "\n")] = 0;
-        printf("NPC: Thank you. Even small reflections change how you move.\n");
-        logLifeLesson("NPC reflection from player:");
-        logLifeLesson(answer);
+// Kogge-Stone fill: grows the seeds through the open bits of one word in both directions
+static inline uint64_t bitFillRuns(uint64_t seeds, uint64_t open) {
+    uint64_t up = seeds, down = seeds, upOpen = open, downOpen = open;
+    for (int k = 1; k < 64; k <<= 1) {
+        up |= upOpen & (up << k);
+        upOpen &= upOpen << k;
+        down |= downOpen & (down >> k);
+        downOpen &= downOpen >> k;
     }
-    printf("----------------------\n");
+    return up | down;
 }
-void askEndOfSessionReflection() {
-    printf("\nDo you want to write a short reflection about this run? (y/n): ");
 
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF) {} // clear leftover input
-    char choice = getchar();
+// Reachability only: a scanline flood that fills a whole horizontal run per row visit and
+// hands the new cells to the rows above and below. No levels, so it does not stall on
+// long corridors the way the level-by-level run does. Returns the number of cells reached,
+// the seen plane is the mask.
+long bitBfsReach(BitBfs *b, int fromX, int fromY) {
+    int rows = b->rows, words = b->words;
+    memset(b->seen, 0, (size_t)(rows + 2) * b->stride * sizeof(uint64_t));
+    memset(b->stamp, 0, (size_t)rows * sizeof(int));   // 1 while the row is on the stack
+    b->levels = 0;
+    b->reached = 0;
+    uint64_t bit = (uint64_t)1 << (fromY & 63);
+    if (!(bitBfsRow(b, b->open, fromX)[fromY >> 6] & bit)) return 0;
 
-    if (choice == 'y' || choice == 'Y') {
-        char line[256];
-        while ((c = getchar()) != '\n' && c != EOF) {} // clear line
-        printf("Write your reflection (one line): ");
-        if (fgets(line, sizeof(line), stdin)) {
-            line[strcspn(line, "\n")] = 0; // remove newline
+    // front holds each row's pending seeds, rows with any are on the active stack
+    bitBfsRow(b, b->front, fromX)[fromY >> 6] = bit;
+    b->lo[fromX] = b->hi[fromX] = fromY >> 6;
+    b->stamp[fromX] = 1;
+    int top = 0;
+    b->active[top++] = fromX;
+    while (top > 0) {
+        int x = b->active[--top];
+        b->stamp[x] = 0;
+        uint64_t *pend = bitBfsRow(b, b->front, x), *open = bitBfsRow(b, b->open, x);
+        // seeds never sit in a seen run, so the filled runs are all new; runs that cross a
+        // word boundary carry up on the first pass and down on the second
+        int lo = b->lo[x], hi = b->hi[x];
+        uint64_t carry = 0;
+        for (int i = lo; i < words && (i <= hi || carry); i++) {
+            pend[i] = bitFillRuns(pend[i] | (carry & open[i]), open[i]);
+            carry = pend[i] >> 63;
+            if (i > hi) hi = i;
+        }
+        carry = 0;
+        for (int i = hi; i >= 0 && (i >= lo || carry); i--) {
+            pend[i] = bitFillRuns(pend[i] | ((carry << 63) & open[i]), open[i]);
+            carry = pend[i] & 1;
+            if (i < lo) lo = i;
+        }
 
-            FILE *f = fopen("journal.txt", "a");
-            if (f) {
-                fprintf(f, "[End-of-session reflection] %s\n", line);
-                fclose(f);
-                printf("Reflection saved to journal.\n");
-            } else {
-                printf("Could not open journal file to save reflection.\n");
+        uint64_t *seen = bitBfsRow(b, b->seen, x);
+        for (int i = lo; i <= hi; i++) {
+            uint64_t filled = pend[i];
+            pend[i] = 0;
+            if (!filled) continue;
+            seen[i] |= filled;
+            b->reached += __builtin_popcountll(filled);
+            for (int nx = x - 1; nx <= x + 1; nx += 2) {
+                if (nx < 0 || nx >= rows) continue;
+                uint64_t seeds = filled & bitBfsRow(b, b->open, nx)[i] & ~bitBfsRow(b, b->seen, nx)[i];
+                if (!seeds) continue;
+                bitBfsRow(b, b->front, nx)[i] |= seeds;
+                if (!b->stamp[nx]) {
+                    b->stamp[nx] = 1;
+                    b->lo[nx] = b->hi[nx] = i;
+                    b->active[top++] = nx;
+                } else {
+                    if (i < b->lo[nx]) b->lo[nx] = i;
+                    if (i > b->hi[nx]) b->hi[nx] = i;
+                }
             }
         }
-    } else {
-        printf("No reflection this time. That’s okay.\n");
     }
+    return b->reached;
 }
 
-
-void waitForEnter() {
-    printf("\nPress Enter to continue...\n");
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF) {} // clear line
+static inline bool bitBfsReached(const BitBfs *b, int x, int y) {
+    return (bitBfsRow(b, b->seen, x)[y >> 6] >> (y & 63)) & 1;
 }
+#endif // PSYMAZE_BENCH
 
+// One DFS frame: the cell, its shuffled direction order and the next direction to try
+typedef struct {
+    int x, y;
+    unsigned char dirs;   // 4 directions packed 2 bits each
+    unsigned char next;   // how many of them were already tried
+} CarveFrame;
 
-//Summarize session stats to a text file (steps, moods, obstacles, philosphy)
-void saveSessionSummary(const char *filename,
-                        int steps,
-                        int moodCounts[3],
-                        int trapCount, int puzzleCount, int bonusCount,
-                        int philosophyUses) {
-    FILE *f = fopen(filename, "a");
+// Stats about the last generateMaze call
+typedef struct {
+    double millis;        // wall-clock generation time
+    size_t peakBytes;     // maze + visited grid + DFS stack at their largest
+    int maxDepth;         // deepest the DFS stack went
+} GenStats;
+
+double nowMillis() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// --- Profiling ---
+// Built with -DPSYMAZE_PROFILE, the hot paths time every call into one histogram per phase:
+// maze generation and each DFS carve, obstacles, NPC placement, every morph and par solve,
+// every frame, each life lesson and journal flush, and the time spent waiting for a key.
+// 'P' in the game shows count, mean, p50, p99 and max per phase; the end of the game prints
+// them again and appends them to session_profile.tsv. Without the flag PROFILE_START and
+// PROFILE_STOP expand to nothing and the hot paths are unchanged.
+#define PROFILE_DUMP "session_profile.tsv"
+
+typedef enum {
+    PROF_GENERATE, PROF_CARVE, PROF_OBSTACLES, PROF_NPCS, PROF_MORPH, PROF_SOLVE, PROF_FRAME,
+    PROF_LESSON, PROF_JOURNAL_FLUSH, PROF_INPUT, PROF_PHASES
+} ProfilePhase;
+
+const char *profileNames[PROF_PHASES] = {"generate", "carve", "obstacles", "npcs", "morph", "solve",
+                                         "frame", "lesson", "journal-flush", "input-wait"};
+
+#ifdef PSYMAZE_PROFILE
+#define PROFILE_SUB_BITS 3
+#define PROFILE_SUB (1 << PROFILE_SUB_BITS)   // bins per power of two, 12.5% wide
+#define PROFILE_BINS (64 * PROFILE_SUB)
+
+// Updated from any thread (tiled carving, the journal flusher, server workers) with relaxed atomics
+typedef struct {
+    atomic_ulong count, sumNs, maxNs;
+    atomic_ulong bins[PROFILE_BINS];
+} ProfileHist;
+
+ProfileHist profileHists[PROF_PHASES];
+
+static inline uint64_t profileNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Exact below 2 * PROFILE_SUB ns, then PROFILE_SUB bins per power of two
+static inline int profileBin(uint64_t ns) {
+    if (ns < 2 * PROFILE_SUB) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    return e * PROFILE_SUB + (int)((ns >> (e - PROFILE_SUB_BITS)) & (PROFILE_SUB - 1));
+}
+
+// First value past bin b, in ns
+static uint64_t profileBinEdge(int b) {
+    if (b < 2 * PROFILE_SUB) return (uint64_t)b + 1;
+    int e = b / PROFILE_SUB, m = b % PROFILE_SUB;
+    return (uint64_t)(PROFILE_SUB + m + 1) << (e - PROFILE_SUB_BITS);
+}
+
+void profileAdd(ProfilePhase phase, uint64_t ns) {
+    ProfileHist *h = &profileHists[phase];
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sumNs, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->bins[profileBin(ns)], 1, memory_order_relaxed);
+    unsigned long max = atomic_load_explicit(&h->maxNs, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&h->maxNs, &max, ns, memory_order_relaxed,
+                                                              memory_order_relaxed)) {}
+}
+
+// Upper edge of the bin holding the p-th fraction of the calls (never past the slowest), in ns
+uint64_t profilePercentile(const ProfileHist *h, double p) {
+    unsigned long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    unsigned long max = atomic_load_explicit(&h->maxNs, memory_order_relaxed);
+    unsigned long rank = (unsigned long)(p * count), seen = 0;
+    if (rank < p * count || rank < 1) rank++;
+    for (int b = 0; b < PROFILE_BINS; b++) {
+        seen += atomic_load_explicit(&h->bins[b], memory_order_relaxed);
+        if (seen >= rank) return profileBinEdge(b) < max ? profileBinEdge(b) : max;
+    }
+    return max;
+}
+
+#define PROFILE_START(t) uint64_t t = profileNow()
+#define PROFILE_STOP(t, phase) profileAdd(phase, profileNow() - (t))
+// leaves the time since PROFILE_START(inner) out of t, for a span another phase already timed
+#define PROFILE_SKIP(t, inner) ((t) += profileNow() - (inner))
+#else
+#define PROFILE_START(t) (void)0
+#define PROFILE_STOP(t, phase) (void)0
+#define PROFILE_SKIP(t, inner) (void)0
+#endif
+
+// The table 'P' shows, one line per phase that ran
+void profileFormat(char *buf, size_t cap) {
+#ifdef PSYMAZE_PROFILE
+    size_t len = (size_t)snprintf(buf, cap, "%-14s %9s %11s %10s %10s %10s %10s\n", "phase", "count",
+                                  "total ms", "mean us", "p50 us", "p99 us", "max us");
+    for (int p = 0; p < PROF_PHASES && len < cap; p++) {
+        const ProfileHist *h = &profileHists[p];
+        unsigned long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        if (count == 0) continue;
+        double sum = (double)atomic_load_explicit(&h->sumNs, memory_order_relaxed);
+        len += (size_t)snprintf(buf + len, cap - len, "%-14s %9lu %11.2f %10.2f %10.2f %10.2f %10.2f\n",
+                                profileNames[p], count, sum / 1e6, sum / count / 1e3,
+                                profilePercentile(h, 0.5) / 1e3, profilePercentile(h, 0.99) / 1e3,
+                                atomic_load_explicit(&h->maxNs, memory_order_relaxed) / 1e3);
+    }
+#else
+    snprintf(buf, cap, "Profiling is off, build with -DPSYMAZE_PROFILE to turn it on.\n");
+#endif
+}
+
+// End of the game: prints the table and appends one tab-separated row per phase to PROFILE_DUMP
+// (unix time, seed, phase, count, total ms, mean, p50, p99 and max in us). Nothing without the flag.
+void profileReport(uint64_t seed) {
+#ifdef PSYMAZE_PROFILE
+    char table[2048];
+    profileFormat(table, sizeof(table));
+    printf("\n===== PROFILE =====\n%s", table);
+    struct stat st;
+    bool fresh = stat(PROFILE_DUMP, &st) != 0 || st.st_size == 0;
+    FILE *f = fopen(PROFILE_DUMP, "a");
     if (!f) {
-        printf("Could not open summary file.\n");
+        printf("Could not open %s file.\n", PROFILE_DUMP);
+        return;
+    }
+    if (fresh) fprintf(f, "time\tseed\tphase\tcount\ttotal_ms\tmean_us\tp50_us\tp99_us\tmax_us\n");
+    long long now = (long long)time(NULL);
+    for (int p = 0; p < PROF_PHASES; p++) {
+        const ProfileHist *h = &profileHists[p];
+        unsigned long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        if (count == 0) continue;
+        double sum = (double)atomic_load_explicit(&h->sumNs, memory_order_relaxed);
+        fprintf(f, "%lld\t%llu\t%s\t%lu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", now, (unsigned long long)seed,
+                profileNames[p], count, sum / 1e6, sum / count / 1e3, profilePercentile(h, 0.5) / 1e3,
+                profilePercentile(h, 0.99) / 1e3, atomic_load_explicit(&h->maxNs, memory_order_relaxed) / 1e3);
+    }
+    fclose(f);
+    printf("Profile appended to %s\n", PROFILE_DUMP);
+#else
+    (void)seed;
+#endif
+}
+
+// Iterative DFS carver with an explicit stack, so depth is only bounded by memory.
+// Walks the same order as the old recursive version (one shuffle per cell).
+// Lattice cells are opened exactly when visited, so the open bit doubles as "visited".
+// Only cells inside rows [x0, x1) and cols [y0, y1) are carved, which lets tiles run in parallel.
+// scratch, when given, holds a frame for every lattice cell of the region, so it never fills up.
+void carveMaze(Grid *g, int startX, int startY, int x0, int y0, int x1, int y1,
+               CarveFrame *scratch, int scratchCap, Rng *rng, GenStats *stats) {
+    int cap = scratch ? scratchCap : 1024;
+    int top = 0;
+    CarveFrame *stack = scratch ? scratch : (CarveFrame *)countedMalloc(cap * sizeof(CarveFrame));
+    if (!stack) {
+        printf("Not enough memory to carve the maze.\n");
+        return;
+    }
+    PROFILE_START(profile);
+
+    int dirs[4] = {0, 1, 2, 3};
+    gridSetOpen(g, startX, startY, true);
+    shuffleDirections(dirs, rng);
+    stack[top++] = (CarveFrame){startX, startY,
+                                (unsigned char)(dirs[0] | dirs[1] << 2 | dirs[2] << 4 | dirs[3] << 6), 0};
+
+    while (top > 0) {
+        CarveFrame *f = &stack[top - 1];
+        if (f->next == 4) { top--; continue; }   // all directions tried, backtrack
+
+        int d = (f->dirs >> (2 * f->next)) & 3;
+        f->next++;
+        int nx = f->x + DX[d] * 2;
+        int ny = f->y + DY[d] * 2;
+        if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1 || gridIsOpen(g, nx, ny)) continue;
+
+        gridSetOpen(g, f->x + DX[d], f->y + DY[d], true);
+        gridSetOpen(g, nx, ny, true);
+
+        if (top == cap) {
+            CarveFrame *bigger = stack == scratch ? NULL
+                                                  : (CarveFrame *)countedRealloc(stack, 2 * (size_t)cap * sizeof(CarveFrame));
+            if (!bigger) {
+                printf("Not enough memory to carve the maze.\n");
+                break;
+            }
+            stack = bigger;
+            cap *= 2;
+        }
+        for (int i = 0; i < 4; i++) dirs[i] = i;
+        shuffleDirections(dirs, rng);
+        stack[top++] = (CarveFrame){nx, ny,
+                                    (unsigned char)(dirs[0] | dirs[1] << 2 | dirs[2] << 4 | dirs[3] << 6), 0};
+        if (stats && top > stats->maxDepth) stats->maxDepth = top;
+    }
+
+    if (stats) stats->peakBytes += (size_t)cap * sizeof(CarveFrame);
+    if (stack != scratch) free(stack);
+    PROFILE_STOP(profile, PROF_CARVE);
+}
+
+typedef enum { GEN_DFS, GEN_TILED } GenMode;
+
+// How generateMaze should build the maze, NULL means single-threaded DFS
+typedef struct {
+    GenMode mode;
+    int threads;          // GEN_TILED: worker threads, <= 0 uses every core
+    CarveFrame *stack;    // GEN_DFS: stackCap frames to carve with instead of a heap stack
+    int stackCap;
+} GenConfig;
+
+// One tile of the lattice (even cells), carved by one worker with its own Rng
+typedef struct {
+    int x0, y0, x1, y1;   // grid rows [x0, x1), cols [y0, y1)
+    Rng rng;
+    GenStats stats;
+} GenTile;
+
+typedef struct {
+    Grid *grid;
+    GenTile *tiles;
+    int tileCount;
+    int worker, workers;
+} GenWorker;
+
+void *carveTilesWorker(void *arg) {
+    GenWorker *w = (GenWorker *)arg;
+    // tiles are dealt round-robin so the split never depends on scheduling
+    for (int t = w->worker; t < w->tileCount; t += w->workers) {
+        GenTile *tile = &w->tiles[t];
+        carveMaze(w->grid, tile->x0, tile->y0, tile->x0, tile->y0, tile->x1, tile->y1, NULL, 0, &tile->rng,
+                  &tile->stats);
+    }
+    return NULL;
+}
+
+int findTileRoot(int *parent, int t) {
+    while (parent[t] != t) {
+        parent[t] = parent[parent[t]];
+        t = parent[t];
+    }
+    return t;
+}
+
+// Carve independent tiles on worker threads, then join them with a random spanning
+// tree of tiles: one opening per tree edge keeps the result a perfect maze.
+// Tile streams come from rng, so the same seed and thread count give the same maze.
+void generateTiledMaze(Grid *g, const GenConfig *cfg, Rng *rng, GenStats *stats) {
+    int threads = cfg->threads > 0 ? cfg->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+
+    // about four tiles per thread for load balance, but no tile under 16 lattice cells a side
+    int latticeRows = (g->rows + 1) / 2, latticeCols = (g->cols + 1) / 2;
+    int perSide = 1;
+    while (perSide * perSide < threads * 4) perSide++;
+    int tilesX = perSide < latticeRows / 16 ? perSide : latticeRows / 16;
+    int tilesY = perSide < latticeCols / 16 ? perSide : latticeCols / 16;
+    if (tilesX < 1) tilesX = 1;
+    if (tilesY < 1) tilesY = 1;
+    int tileCount = tilesX * tilesY;
+
+    GenTile *tiles = (GenTile *)countedCalloc(tileCount, sizeof(GenTile));
+    int *parent = (int *)countedMalloc(tileCount * sizeof(int));
+    int *edges = (int *)countedMalloc(2 * tileCount * sizeof(int));
+    GenWorker *workers = (GenWorker *)countedMalloc(threads * sizeof(GenWorker));
+    pthread_t *ids = (pthread_t *)countedMalloc(threads * sizeof(pthread_t));
+    if (!tiles || !parent || !edges || !workers || !ids) {
+        printf("Not enough memory to split the maze into tiles.\n");
+        free(tiles); free(parent); free(edges); free(workers); free(ids);
+        return;
+    }
+
+    uint64_t tileSeed = (uint64_t)rngNext(rng) << 32 | rngNext(rng);
+    for (int tx = 0; tx < tilesX; tx++) {
+        for (int ty = 0; ty < tilesY; ty++) {
+            GenTile *tile = &tiles[tx * tilesY + ty];
+            // tile edges sit on lattice rows/cols, the odd wall line between tiles stays closed
+            tile->x0 = 2 * (latticeRows * tx / tilesX);
+            tile->x1 = 2 * (latticeRows * (tx + 1) / tilesX) - 1;
+            tile->y0 = 2 * (latticeCols * ty / tilesY);
+            tile->y1 = 2 * (latticeCols * (ty + 1) / tilesY) - 1;
+            if (tile->x1 > g->rows) tile->x1 = g->rows;
+            if (tile->y1 > g->cols) tile->y1 = g->cols;
+            rngSeed(&tile->rng, tileSeed, (uint64_t)(tx * tilesY + ty + 1));
+        }
+    }
+
+    int workerCount = threads < tileCount ? threads : tileCount;
+    for (int w = 0; w < workerCount; w++) {
+        workers[w] = (GenWorker){g, tiles, tileCount, w, workerCount};
+        if (w > 0 && pthread_create(&ids[w], NULL, carveTilesWorker, &workers[w]) != 0) {
+            workers[w].workers = -1;   // could not start, carve those tiles here
+        }
+    }
+    carveTilesWorker(&workers[0]);
+    for (int w = 1; w < workerCount; w++) {
+        if (workers[w].workers == -1) {
+            workers[w].workers = workerCount;
+            carveTilesWorker(&workers[w]);
+        } else {
+            pthread_join(ids[w], NULL);
+        }
+    }
+
+    // randomized Kruskal over the tile graph, edge e: tile e/2 to its lower (0) or right (1) neighbour
+    int edgeCount = 0;
+    for (int t = 0; t < tileCount; t++) {
+        parent[t] = t;
+        if (t / tilesY + 1 < tilesX) edges[edgeCount++] = 2 * t;
+        if (t % tilesY + 1 < tilesY) edges[edgeCount++] = 2 * t + 1;
+    }
+    for (int i = edgeCount - 1; i > 0; i--) {
+        int j = rngBelow(rng, i + 1);
+        int tmp = edges[i]; edges[i] = edges[j]; edges[j] = tmp;
+    }
+    for (int i = 0; i < edgeCount; i++) {
+        int t = edges[i] / 2;
+        bool down = edges[i] % 2 == 0;
+        int other = down ? t + tilesY : t + 1;
+        int ra = findTileRoot(parent, t), rb = findTileRoot(parent, other);
+        if (ra == rb) continue;
+        parent[ra] = rb;
+
+        // open the wall cell between two lattice cells on the shared border
+        GenTile *tile = &tiles[t];
+        if (down) {
+            int lattice = (tile->y1 - tile->y0 + 1) / 2;
+            gridSetOpen(g, tile->x1, tile->y0 + 2 * rngBelow(rng, lattice), true);
+        } else {
+            int lattice = (tile->x1 - tile->x0 + 1) / 2;
+            gridSetOpen(g, tile->x0 + 2 * rngBelow(rng, lattice), tile->y1, true);
+        }
+    }
+
+    if (stats) {
+        stats->peakBytes += (size_t)tileCount * (sizeof(GenTile) + 3 * sizeof(int));
+        for (int t = 0; t < tileCount; t++) {
+            // stacks of tiles running at once can coexist, count them all
+            stats->peakBytes += tiles[t].stats.peakBytes;
+            if (tiles[t].stats.maxDepth > stats->maxDepth) stats->maxDepth = tiles[t].stats.maxDepth;
+        }
+    }
+    free(tiles); free(parent); free(edges); free(workers); free(ids);
+}
+
+//Generate maze using iterative backtracking (DFS), or tiles on several threads; cfg and stats may be NULL
+void generateMaze(Grid *g, int exitX, int exitY, const GenConfig *cfg, Rng *rng, GenStats *stats) {
+    double start = nowMillis();
+    PROFILE_START(profile);
+    if (stats) {
+        stats->maxDepth = 1;
+        stats->peakBytes = (size_t)g->rows * g->cols;
+    }
+    memset(g->cells, 0, (size_t)g->rows * g->cols);
+    if (cfg && cfg->mode == GEN_TILED) generateTiledMaze(g, cfg, rng, stats);
+    else carveMaze(g, 0, 0, 0, 0, g->rows, g->cols, cfg ? cfg->stack : NULL, cfg ? cfg->stackCap : 0, rng, stats);
+    gridSetOpen(g, exitX, exitY, true);
+    if (stats) stats->millis = nowMillis() - start;
+    PROFILE_STOP(profile, PROF_GENERATE);
+}
+
+// Headless runs play the game logic with no messages or prompts
+bool headless = false;
+// Replay turns journal writes off too, the benchmark keeps them to time the journal
+bool journalWrites = true;
+
+// The raw-mode loop collects messages here and prints them under the next frame; the server
+// sends them with the reply. Per thread, since every server worker plays its own sessions.
+#define SAY_BUFFER_LEN 4096
+_Thread_local char sayBuffer[SAY_BUFFER_LEN];
+_Thread_local size_t sayLen = 0;
+_Thread_local bool sayCapture = false;
+
+// The server collects each key's life lessons here and appends them to the player's own journal
+#define LESSON_BUFFER_LEN 4096
+_Thread_local char lessonBuffer[LESSON_BUFFER_LEN];
+_Thread_local size_t lessonLen = 0;
+_Thread_local bool lessonCapture = false;
+
+// The server plays many sessions at once: nothing may prompt or read stdin
+bool serving = false;
+
+// printf for in-game messages, silent when headless
+void say(const char *fmt, ...) {
+    if (headless) return;
+    va_list args;
+    va_start(args, fmt);
+    if (sayCapture) {
+        int n = vsnprintf(sayBuffer + sayLen, SAY_BUFFER_LEN - sayLen, fmt, args);
+        if (n > 0) sayLen += (size_t)n < SAY_BUFFER_LEN - sayLen ? (size_t)n : SAY_BUFFER_LEN - 1 - sayLen;
+    } else {
+        vprintf(fmt, args);
+    }
+    va_end(args);
+}
+
+// --- Terminal ---
+// With a terminal on both ends the game reads single keys in raw mode (no echo, no line
+// buffering, no signals: Ctrl-C arrives as a key). Anything that asks for a line of text
+// switches back to normal input for just that line.
+typedef struct {
+    struct termios saved;
+    bool active;
+} Terminal;
+
+Terminal terminal = {0};
+bool rawInput = false;   // this run reads single keys, so no move leaves a newline behind
+
+bool terminalRaw() {
+    if (terminal.active) return true;
+    if (tcgetattr(STDIN_FILENO, &terminal.saved) != 0) return false;
+    struct termios raw = terminal.saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return false;
+    terminal.active = true;
+    return true;
+}
+
+void terminalRestore() {
+    if (!terminal.active) return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &terminal.saved);
+    terminal.active = false;
+}
+
+// Skips the rest of the input line, which the line loop leaves after every move key
+void skipInputLine() {
+    if (rawInput) return;
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {}
+}
+
+// Reads one line of text with echo, also in the middle of a raw-mode run
+bool readTextLine(char *line, int size) {
+    bool wasRaw = terminal.active;
+    terminalRestore();
+    bool ok = fgets(line, size, stdin) != NULL;
+    if (ok) line[strcspn(line, "\n")] = 0;
+    if (wasRaw) terminalRaw();
+    return ok;
+}
+
+// --- Journal writer ---
+// Life lessons are copied into a ring of fixed-size slots and a background thread writes
+// them to journal.txt, which stays open for the whole session. The game thread only waits
+// when the flusher is a whole ring behind. The flusher drains everything queued each time
+// it wakes and fflushes after flushEvery entries or flushMillis ms, whichever comes first.
+// head is only stored by the game thread and tail only by the flusher, so the ring itself
+// needs no lock; the mutex is for sleeping and for journalFlush.
+#define JOURNAL_FILE "journal.txt"
+#define JOURNAL_SLOTS 256            // 128 KB of slots, the most the journal ever holds
+#define JOURNAL_SLOT_LEN 512         // longer lines are cut
+#define JOURNAL_SEGMENTS 4           // rotated segments kept next to the live file
+#define JOURNAL_PAGE 20              // entries per page in the viewer
+
+// --- Journal index ---
+// FILE.idx holds a header and one fixed-size record per journal line, appended by the
+// flusher as it writes the line. Entry k is record k, so the viewer finds the last N
+// entries, a page or (by binary search on the session number) a session without reading
+// the journal itself. Lines the index missed, from older builds or the direct fallback
+// in logLifeLesson, are indexed by journalIndexCatchUp the next time the journal opens.
+#define JOURNAL_INDEX_MAGIC "PSYMJIX1"
+
+typedef struct {
+    uint64_t offset;      // first byte of the line in the journal file
+    uint32_t length;      // without the newline
+    uint32_t session;     // run that wrote it, counting up from 1
+} JournalIndexEntry;
+
+typedef struct {
+    char magic[8];
+    uint64_t reserved;
+} JournalIndexHeader;
+
+void journalIndexPath(char *out, size_t size, const char *journalPath) {
+    snprintf(out, size, "%s.idx", journalPath);
+}
+
+// Indexes every complete line after the last indexed one and leaves the index open for
+// appending in *indexOut (closed if indexOut is NULL). Returns the journal size covered by
+// the index and the last session number seen, or -1 if the index could not be opened.
+long long journalIndexCatchUp(const char *journalPath, FILE **indexOut, uint32_t *lastSession) {
+    char indexPath[512];
+    journalIndexPath(indexPath, sizeof(indexPath), journalPath);
+    *lastSession = 0;
+    FILE *idx = fopen(indexPath, "r+b");
+    if (!idx) idx = fopen(indexPath, "w+b");
+    if (!idx) return -1;
+
+    JournalIndexHeader header;
+    uint64_t end = 0;
+    fseek(idx, 0, SEEK_END);
+    long size = ftell(idx);
+    rewind(idx);
+    if (size < (long)sizeof(header) || fread(&header, sizeof(header), 1, idx) != 1 ||
+        memcmp(header.magic, JOURNAL_INDEX_MAGIC, 8) != 0) {
+        size = 0;   // missing or foreign, start over
+    } else {
+        size -= (size - (long)sizeof(header)) % (long)sizeof(JournalIndexEntry);   // drop a torn record
+    }
+    if (size > (long)sizeof(header)) {
+        JournalIndexEntry last;
+        fseek(idx, size - (long)sizeof(last), SEEK_SET);
+        if (fread(&last, sizeof(last), 1, idx) == 1) {
+            end = last.offset + last.length + 1;
+            *lastSession = last.session;
+        }
+    }
+
+    struct stat st;
+    uint64_t journalSize = stat(journalPath, &st) == 0 ? (uint64_t)st.st_size : 0;
+    if (journalSize < end) {
+        // the journal was replaced or cut behind the index's back
+        size = 0;
+        end = 0;
+        *lastSession = 0;
+    }
+    if (size == 0) {
+        memcpy(header.magic, JOURNAL_INDEX_MAGIC, 8);
+        header.reserved = 0;
+        rewind(idx);
+        fwrite(&header, sizeof(header), 1, idx);
+        size = sizeof(header);
+    }
+    fflush(idx);
+    if (ftruncate(fileno(idx), size) != 0) size = -1;
+    fseek(idx, 0, SEEK_END);
+
+    if (size >= 0 && journalSize > end) {
+        int fd = open(journalPath, O_RDONLY);
+        char *text = fd >= 0 ? (char *)mmap(NULL, journalSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if (fd >= 0) close(fd);
+        if (text != MAP_FAILED) {
+            for (uint64_t at = end; at < journalSize; ) {
+                const char *nl = (const char *)memchr(text + at, '\n', journalSize - at);
+                if (!nl) break;   // a line still being written
+                JournalIndexEntry e = {at, (uint32_t)(nl - (text + at)), *lastSession};
+                fwrite(&e, sizeof(e), 1, idx);
+                at = (uint64_t)(nl - text) + 1;
+                end = at;
+            }
+            munmap(text, journalSize);
+        }
+        fflush(idx);
+    }
+    if (indexOut) *indexOut = idx;
+    else fclose(idx);
+    return size < 0 ? -1 : (long long)end;
+}
+
+#ifdef PSYMAZE_ZLIB
+// gzips a rotated segment to path.gz and removes the plain copy once that is complete
+void journalCompressSegment(const char *path) {
+    char gzPath[512];
+    snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    FILE *in = fopen(path, "rb");
+    gzFile out = in ? gzopen(gzPath, "wb1") : NULL;
+    if (!in || !out) {
+        if (in) fclose(in);
+        printf("Could not compress journal segment %s.\n", path);
+        return;
+    }
+    char buffer[1 << 16];
+    size_t got;
+    bool ok = true;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (gzwrite(out, buffer, (unsigned)got) != (int)got) ok = false;
+    }
+    fclose(in);
+    if (gzclose(out) != Z_OK) ok = false;
+    if (ok) remove(path);
+    else remove(gzPath);
+}
+#endif
+
+// journal.txt becomes journal.txt.1, older segments move up one and the oldest is dropped,
+// so the journal never takes more than JOURNAL_SEGMENTS + 1 times the rotation size
+void journalRotateSegments(const char *path) {
+    char from[512], to[512];
+    for (int k = JOURNAL_SEGMENTS; k >= 1; k--) {
+        const char *suffixes[2] = {"", ".gz"};
+        for (int s = 0; s < 2; s++) {
+            snprintf(from, sizeof(from), "%s.%d%s", path, k, suffixes[s]);
+            if (k == JOURNAL_SEGMENTS) {
+                remove(from);
+            } else {
+                snprintf(to, sizeof(to), "%s.%d%s", path, k + 1, suffixes[s]);
+                rename(from, to);
+            }
+        }
+    }
+    snprintf(to, sizeof(to), "%s.1", path);
+    rename(path, to);
+    journalIndexPath(from, sizeof(from), path);
+    remove(from);
+#ifdef PSYMAZE_ZLIB
+    journalCompressSegment(to);
+#endif
+}
+
+typedef struct {
+    int flushEvery;       // entries between fflushes, 0 = timer only
+    int flushMillis;      // longest an entry sits in the stdio buffer
+    bool syncOnClose;     // fsync journal.txt when the session ends
+    long long rotateBytes;  // rotate once the live file is this big, 0 = never
+} JournalConfig;
+
+typedef struct {
+    FILE *file;
+    FILE *index;
+    char path[256];
+    uint64_t offset;         // size of the live file, flusher only
+    uint32_t session;
+    JournalConfig cfg;
+    char (*slots)[JOURNAL_SLOT_LEN];
+    _Atomic size_t head;     // entries queued so far
+    _Atomic size_t tail;     // entries written to the FILE so far
+    size_t flushed;          // entries fflushed so far, under lock
+    size_t flushTarget;      // journalFlush waits until flushed reaches this, under lock
+    bool stop;               // under lock
+    bool running;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;     // flusher sleeps here
+    pthread_cond_t done;     // producers wait here for room or for a flush
+    long fullWaits;          // times the game thread found the ring full
+} Journal;
+
+Journal journal;
+const char *journalFile = JOURNAL_FILE;
+
+// Entries the flusher lets pile up before it wakes, it writes them in one go
+static inline size_t journalBatch(const Journal *j) {
+    size_t batch = j->cfg.flushEvery > 0 ? (size_t)j->cfg.flushEvery : JOURNAL_SLOTS / 2;
+    return batch < JOURNAL_SLOTS / 2 ? batch : JOURNAL_SLOTS / 2;
+}
+
+// Starts a fresh live file (and index), called when the file has outgrown cfg.rotateBytes
+void journalRotate(Journal *j) {
+    fclose(j->file);
+    if (j->index) fclose(j->index);
+    journalRotateSegments(j->path);
+    j->file = fopen(j->path, "a");
+    uint32_t lastSession;
+    j->index = NULL;
+    journalIndexCatchUp(j->path, &j->index, &lastSession);
+    j->offset = 0;
+    if (!j->file) {
+        // nowhere to write, keep draining into /dev/null rather than blocking the game
+        j->file = fopen("/dev/null", "w");
+    }
+}
+
+void *journalFlusher(void *arg) {
+    Journal *j = (Journal *)arg;
+    size_t unflushed = 0;
+    double lastFlush = nowMillis();
+    for (;;) {
+        pthread_mutex_lock(&j->lock);
+        if (!j->stop && j->flushed >= j->flushTarget &&
+            atomic_load_explicit(&j->head, memory_order_acquire) - atomic_load_explicit(&j->tail, memory_order_relaxed) < journalBatch(j)) {
+            struct timespec now, until;
+            clock_gettime(CLOCK_REALTIME, &now);
+            long nanos = now.tv_nsec + (long)j->cfg.flushMillis * 1000000L;
+            until.tv_sec = now.tv_sec + nanos / 1000000000L;
+            until.tv_nsec = nanos % 1000000000L;
+            pthread_cond_timedwait(&j->wake, &j->lock, &until);
+        }
+        bool stop = j->stop;
+        bool requested = j->flushed < j->flushTarget;
+        pthread_mutex_unlock(&j->lock);
+
+        size_t head = atomic_load_explicit(&j->head, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&j->tail, memory_order_relaxed);
+        for (; tail != head; tail++) {
+            const char *slot = j->slots[tail % JOURNAL_SLOTS];
+            JournalIndexEntry e = {j->offset, (uint32_t)strlen(slot), j->session};
+            fwrite(slot, 1, e.length, j->file);
+            fputc('\n', j->file);
+            if (j->index) fwrite(&e, sizeof(e), 1, j->index);
+            j->offset += e.length + 1;
+            unflushed++;
+        }
+        atomic_store_explicit(&j->tail, tail, memory_order_release);
+
+        double now = nowMillis();
+        if (unflushed > 0 && (stop || requested || (j->cfg.flushEvery > 0 && unflushed >= (size_t)j->cfg.flushEvery) ||
+                              now - lastFlush >= j->cfg.flushMillis)) {
+            PROFILE_START(profile);
+            fflush(j->file);
+            if (j->index) fflush(j->index);
+            PROFILE_STOP(profile, PROF_JOURNAL_FLUSH);
+            unflushed = 0;
+            lastFlush = now;
+            if (j->cfg.rotateBytes > 0 && j->offset >= (uint64_t)j->cfg.rotateBytes) journalRotate(j);
+        }
+        pthread_mutex_lock(&j->lock);
+        if (unflushed == 0) j->flushed = tail;
+        pthread_cond_broadcast(&j->done);
+        pthread_mutex_unlock(&j->lock);
+        if (stop) return NULL;
+    }
+}
+
+// Opens (appends to) the journal file and starts the flusher, false if either fails
+bool journalOpen(Journal *j, const char *filename, JournalConfig cfg) {
+    memset(j, 0, sizeof(*j));
+    if (cfg.flushMillis < 1) cfg.flushMillis = 1;
+    j->cfg = cfg;
+    snprintf(j->path, sizeof(j->path), "%s", filename);
+    struct stat st;
+    if (cfg.rotateBytes > 0 && stat(filename, &st) == 0 && st.st_size >= cfg.rotateBytes) {
+        journalRotateSegments(filename);
+    }
+    uint32_t lastSession;
+    long long indexed = journalIndexCatchUp(filename, &j->index, &lastSession);
+    j->session = lastSession + 1;
+    j->file = fopen(filename, "a");
+    j->slots = (char (*)[JOURNAL_SLOT_LEN])countedMalloc((size_t)JOURNAL_SLOTS * JOURNAL_SLOT_LEN);
+    if (!j->file || !j->slots) {
+        if (j->file) fclose(j->file);
+        if (j->index) fclose(j->index);
+        free(j->slots);
+        return false;
+    }
+    // a torn last line (no newline) stays out of the index, new entries start after it
+    j->offset = (uint64_t)ftell(j->file);
+    if (indexed < 0) printf("Could not open the journal index, the viewer will rebuild it.\n");
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->wake, NULL);
+    pthread_cond_init(&j->done, NULL);
+    if (pthread_create(&j->thread, NULL, journalFlusher, j) != 0) {
+        fclose(j->file);
+        if (j->index) fclose(j->index);
+        free(j->slots);
+        return false;
+    }
+    j->running = true;
+    return true;
+}
+
+void journalAppend(Journal *j, const char *message) {
+    size_t head = atomic_load_explicit(&j->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&j->tail, memory_order_acquire) == JOURNAL_SLOTS) {
+        pthread_mutex_lock(&j->lock);
+        j->fullWaits++;
+        while (head - atomic_load_explicit(&j->tail, memory_order_acquire) == JOURNAL_SLOTS) {
+            pthread_cond_signal(&j->wake);
+            pthread_cond_wait(&j->done, &j->lock);
+        }
+        pthread_mutex_unlock(&j->lock);
+    }
+    char *slot = j->slots[head % JOURNAL_SLOTS];
+    size_t len = strnlen(message, JOURNAL_SLOT_LEN - 1);
+    memcpy(slot, message, len);
+    slot[len] = '\0';
+    atomic_store_explicit(&j->head, head + 1, memory_order_release);
+    // wake the flusher once per batch instead of once per entry
+    if ((head + 1) % journalBatch(j) == 0) {
+        pthread_mutex_lock(&j->lock);
+        pthread_cond_signal(&j->wake);
+        pthread_mutex_unlock(&j->lock);
+    }
+}
+
+// Waits until every entry queued so far has reached the file (but not the disk)
+void journalFlush(Journal *j) {
+    if (!j->running) return;
+    pthread_mutex_lock(&j->lock);
+    j->flushTarget = atomic_load_explicit(&j->head, memory_order_relaxed);
+    pthread_cond_signal(&j->wake);
+    while (j->flushed < j->flushTarget) pthread_cond_wait(&j->done, &j->lock);
+    pthread_mutex_unlock(&j->lock);
+}
+
+// Drains the ring, stops the flusher and fsyncs if the config asks for it
+void journalClose(Journal *j) {
+    if (!j->running) return;
+    pthread_mutex_lock(&j->lock);
+    j->stop = true;
+    pthread_cond_signal(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    pthread_join(j->thread, NULL);
+    fflush(j->file);
+    if (j->cfg.syncOnClose) fsync(fileno(j->file));
+    fclose(j->file);
+    if (j->index) fclose(j->index);
+    free(j->slots);
+    pthread_mutex_destroy(&j->lock);
+    pthread_cond_destroy(&j->wake);
+    pthread_cond_destroy(&j->done);
+    j->running = false;
+}
+
+// Log "life lesson" line onto journal.txt, through the journal writer once it is running
+void logLifeLesson(const char *message) {
+    if (!journalWrites) return;
+    PROFILE_START(profile);
+    if (lessonCapture) {
+        size_t len = strnlen(message, LESSON_BUFFER_LEN - 1 - lessonLen);
+        memcpy(lessonBuffer + lessonLen, message, len);
+        lessonLen += len;
+        if (lessonLen < LESSON_BUFFER_LEN - 1) lessonBuffer[lessonLen++] = '\n';
+    } else if (journal.running) {
+        journalAppend(&journal, message);
+    } else {
+        FILE *f = fopen(journalFile, "a");
+        if (f == NULL) {
+            printf("Could not open journal file.\n");
+        } else {
+            fprintf(f, "%s\n", message);
+            fclose(f);
+        }
+    }
+    PROFILE_STOP(profile, PROF_LESSON);
+}
+
+// Each open tile rolls 1 in trapDiv for a trap, a puzzle and a bonus; higher levels roll smaller dice
+int obstacleTrapDiv(int chosenLevel) {
+    int baseDiv = rules.baseDiv;
+    int levelFactor = chosenLevel / rules.levelsPerDiv;
+    int trapDiv = baseDiv - levelFactor;
+    if(trapDiv < rules.minTrapDiv) trapDiv = rules.minTrapDiv;
+    return trapDiv;
+}
+
+int rollObstacle(int trapDiv, Rng *rng) {
+    int r = rngBelow(rng, trapDiv); // You can lower for more obstacles
+    if (r == 0) return TRAP;
+    if (r == 1) return PUZZLE;
+    if (r == 2) return BONUS;
+    return NONE;
+}
+
+//Place traps, puzzles, bonuses and power-ups, difficulty level can be chosen with chosenLevel
+void placeObstacles(Grid *g, CellIndex *idx, int exitX, int exitY, int chosenLevel, Rng *rng) {
+    PROFILE_START(profile);
+    int rows = g->rows, cols = g->cols;
+    int trapDiv = obstacleTrapDiv(chosenLevel);
+
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (gridIsOpen(g, i, j) && !(i == 0 && j == 0) && !(i == exitX && j == exitY)) {
+                gridSetObstacle(g, i, j, rollObstacle(trapDiv, rng));
+            } else {
+                gridSetObstacle(g, i, j, NONE);
+            }
+        }
+    }
+    int powerupCount = rows * cols / rules.powerupCells; // small number
+
+    // partial Fisher-Yates over the open cells: every draw is a fresh tile, so exactly
+    // powerupCount land unless the maze runs out of free tiles first
+    int placed = 0;
+    for (int k = 0; k < idx->openCount && placed < powerupCount; k++) {
+        cellIndexSwap(idx, k, k + rngBelow(rng, idx->openCount - k));
+        int x = idx->cells[k] / cols, y = idx->cells[k] % cols;
+        if (gridObstacle(g, x, y) == NONE && !(x == 0 && y == 0) && !(x == exitX && y == exitY)) {
+            gridSetObstacle(g, x, y, POWERUP);
+            placed++;
+        }
+    }
+    PROFILE_STOP(profile, PROF_OBSTACLES);
+}
+
+// Streamed maze file formats: text rows (# wall, . path, T/Q/B/K obstacles), or a nibble-packed binary
+// (magic "PSYMSTR1", rows, cols as uint32, then each row as (cols+1)/2 bytes of open | obstacle << 1)
+typedef enum { STREAM_TEXT, STREAM_BINARY } StreamFormat;
+
+char streamCellChar(int open, int obs) {
+    if (!open) return '#';
+    if (obs == TRAP) return 'T';
+    if (obs == PUZZLE) return 'Q';
+    if (obs == BONUS) return 'B';
+    if (obs == POWERUP) return 'K';
+    return '.';
+}
+
+int ellerFind(int *parent, int id) {
+    while (parent[id] != id) {
+        parent[id] = parent[parent[id]];
+        id = parent[id];
+    }
+    return id;
+}
+
+// Emit one finished grid row: decorate with obstacles (same odds as placeObstacles) and write it
+void streamWriteRow(FILE *f, StreamFormat format, unsigned char *row, char *text, int x,
+                    int rows, int cols, int trapDiv, Rng *rng) {
+    for (int y = 0; y < cols; y++) {
+        bool start = x == 0 && y == 0, exit = x == rows - 1 && y == cols - 1;
+        if (!(row[y] & CELL_OPEN) || start || exit) continue;
+        int obs = rollObstacle(trapDiv, rng);
+        // placeObstacles drops rows*cols/60 power-ups on random free tiles, here each free tile gets 1/60
+        if (obs == NONE && rngBelow(rng, rules.powerupCells) == 0) obs = POWERUP;
+        row[y] |= obs << CELL_OBS_SHIFT;
+    }
+    if (format == STREAM_TEXT) {
+        for (int y = 0; y < cols; y++) {
+            text[y] = streamCellChar(row[y] & CELL_OPEN, (row[y] & CELL_OBS_MASK) >> CELL_OBS_SHIFT);
+        }
+        if (x == 0) text[0] = 'P';
+        if (x == rows - 1) text[cols - 1] = 'E';
+        text[cols] = '\n';
+        fwrite(text, 1, cols + 1, f);
+    } else {
+        for (int y = 0; y < cols; y += 2) {
+            unsigned char hi = y + 1 < cols ? row[y + 1] & 0x0F : 0;
+            text[y / 2] = (char)((row[y] & 0x0F) | hi << 4);
+        }
+        fwrite(text, 1, (cols + 1) / 2, f);
+    }
+}
+
+// Eller's algorithm: builds the maze one lattice row at a time and writes it straight to the file.
+// Only O(cols) state is kept, so the row count is limited by disk space, not RAM.
+bool streamMaze(const char *filename, int rows, int cols, int chosenLevel, StreamFormat format,
+                RngStreams *rng) {
+    if (rows < 1 || cols < 1) return false;
+    int lc = (cols + 1) / 2;                  // lattice columns (even grid columns)
+    int *set = (int *)countedMalloc(lc * sizeof(int));
+    int *parent = (int *)countedMalloc(2 * lc * sizeof(int));
+    int *remap = (int *)countedMalloc(2 * lc * sizeof(int));
+    int *members = (int *)countedMalloc(2 * lc * sizeof(int));
+    int *pick = (int *)countedMalloc(2 * lc * sizeof(int));
+    unsigned char *down = (unsigned char *)countedMalloc(lc);
+    unsigned char *row = (unsigned char *)countedMalloc(cols);
+    char *text = (char *)countedMalloc(cols + 1);
+    FILE *f = fopen(filename, format == STREAM_TEXT ? "w" : "wb");
+    bool ok = set && parent && remap && members && pick && down && row && text && f;
+    if (!ok) {
+        printf(f ? "Not enough memory to stream the maze.\n" : "Could not open stream file.\n");
+    } else {
+        double start = nowMillis();
+        int trapDiv = obstacleTrapDiv(chosenLevel);
+        if (format == STREAM_TEXT) {
+            fprintf(f, "PsyMaze Snapshot\n");
+            fprintf(f, "Size: %d x %d\n", rows, cols);
+            fprintf(f, "Player: (0,0) Mood: %s\n", moodFaces[NEUTRAL]);
+            fprintf(f, "Exit: (%d,%d)\n", rows - 1, cols - 1);
+            fprintf(f, "Maze:\n");
+        } else {
+            unsigned int header[2] = {(unsigned int)rows, (unsigned int)cols};
+            fwrite("PSYMSTR1", 1, 8, f);
+            fwrite(header, sizeof(header), 1, f);
+        }
+
+        for (int c = 0; c < lc; c++) set[c] = -1;
+        for (int x = 0; x < rows; x += 2) {
+            bool last = x + 2 >= rows;
+
+            // cells that were not joined from above start their own set (ids lc.. are free)
+            for (int c = 0; c < lc; c++) {
+                if (set[c] < 0) set[c] = lc + c;
+                parent[set[c]] = set[c];
+            }
+
+            // randomly join neighbours in different sets, the last row joins everything left
+            memset(row, 0, cols);
+            for (int c = 0; c < lc; c++) row[2 * c] = CELL_OPEN;
+            for (int c = 0; c + 1 < lc; c++) {
+                int a = ellerFind(parent, set[c]), b = ellerFind(parent, set[c + 1]);
+                if (a != b && (last || rngBelow(&rng->gen, 2) == 0)) {
+                    parent[b] = a;
+                    row[2 * c + 1] = CELL_OPEN;
+                }
+            }
+            streamWriteRow(f, format, row, text, x, rows, cols, trapDiv, &rng->obstacles);
+            if (last) break;
+
+            // every set sends at least one cell down; pick[] keeps a random member per set
+            for (int c = 0; c < lc; c++) {
+                int r = ellerFind(parent, set[c]);
+                set[c] = r;
+                members[r] = 0;
+                pick[r] = -1;
+            }
+            for (int c = 0; c < lc; c++) {
+                int r = set[c];
+                down[c] = rngBelow(&rng->gen, 2) == 0;
+                if (down[c]) pick[r] = -2;                      // set already goes down
+                else if (pick[r] != -2 && rngBelow(&rng->gen, ++members[r]) == 0) pick[r] = c;
+            }
+            for (int c = 0; c < lc; c++) {
+                int r = set[c];
+                if (pick[r] >= 0) { down[pick[r]] = 1; pick[r] = -2; }
+            }
+
+            // wall row below, then carry set ids down, renumbered to 0..lc-1
+            memset(row, 0, cols);
+            for (int c = 0; c < lc; c++) remap[set[c]] = -1;
+            int next = 0;
+            for (int c = 0; c < lc; c++) {
+                if (!down[c]) { set[c] = -1; continue; }
+                row[2 * c] = CELL_OPEN;
+                if (remap[set[c]] < 0) remap[set[c]] = next++;
+                set[c] = remap[set[c]];
+            }
+            streamWriteRow(f, format, row, text, x + 1, rows, cols, trapDiv, &rng->obstacles);
+        }
+
+        ok = !ferror(f);
+        long bytes = ftell(f);
+        printf("Streamed %d x %d maze to %s in %.2f ms (%ld bytes, %zu bytes of generator state)\n",
+               rows, cols, filename, nowMillis() - start, bytes,
+               (size_t)lc * (sizeof(int) * 7 + 1) + 2 * (size_t)cols + 1);
+    }
+    if (f && fclose(f) != 0) ok = false;
+    free(set); free(parent); free(remap); free(members); free(pick); free(down); free(row); free(text);
+    return ok;
+}
+
+// --- Frame-buffer renderer ---
+// The whole frame is composed in memory and written with a single write(). On a terminal,
+// later frames only repaint the cells that changed, using ANSI cursor positioning.
+// Mazes bigger than the terminal are shown through a camera window that follows the player,
+// optionally with a minimap of the whole maze beside it, so a frame costs the same on any maze size.
+#define RENDER_MESSAGE_LINES 24   // room kept under the maze for prompts and messages
+#define RENDER_PIPE_CELLS 120     // view size when stdout is not a terminal (every level fits)
+#define MINIMAP_ROWS 16           // most blocks the minimap shows down and across
+#define MINIMAP_COLS 32
+#define MINIMAP_MIN_BLOCK 8
+
+typedef struct {
+    int rows, cols;           // maze size
+    int viewRows, viewCols;   // maze cells on screen
+    int originX, originY;     // maze cell in the top-left corner of the view
+    bool fullMaze;            // --full-maze: the view is always the whole maze
+    bool minimap;
+    BlockSummary map;         // block counts behind the minimap
+    Grid *mapGrid;            // grid the summary is attached to
+    int canvasRows, canvasCols;   // view, then a gap column and the minimap
+    size_t canvasCap;
+    char *glyphs;         // this frame, one char per canvas cell
+    char *shown;          // what the terminal currently shows
+    char *out;            // bytes to write for this frame
+    size_t outLen, outCap;
+    int outFd;            // where frames are written, -1 leaves them in out for the caller
+    bool ansi;            // stdout is a terminal, cursor moves are allowed
+    bool valid;           // shown[] matches the screen, so a diff is enough
+    int screenRows, screenCols;   // terminal size, diffs need the canvas plus messages to fit
+    long frames;
+    size_t lastBytes, totalBytes;
+    double lastMicros, totalMicros;
+} Renderer;
+
+char cellGlyphs[256];   // cell byte -> glyph, ignoring player and exit
+
+void buildCellGlyphs() {
+    for (int c = 0; c < 256; c++) {
+        int obs = (c & CELL_OBS_MASK) >> CELL_OBS_SHIFT;
+        if (c & CELL_NPC) cellGlyphs[c] = 'N';             // show NPC
+        else if (obs == TRAP) cellGlyphs[c] = 'T';
+        else if (obs == PUZZLE) cellGlyphs[c] = 'Q';
+        else if (obs == BONUS) cellGlyphs[c] = 'B';
+        else if (obs == POWERUP) cellGlyphs[c] = 'K';   // K = key/power
+        else if (c & CELL_OPEN) cellGlyphs[c] = (c & CELL_VISITED) ? '*' : '.';
+        else cellGlyphs[c] = '#';
+    }
+}
+
+// Make room for len more bytes, the buffer is kept between frames so this rarely allocates
+bool renderReserve(Renderer *r, size_t len) {
+    if (r->outLen + len <= r->outCap) return true;
+    size_t cap = r->outCap * 2 + len;
+    char *bigger = (char *)countedRealloc(r->out, cap);
+    if (!bigger) return false;
+    r->out = bigger;
+    r->outCap = cap;
+    return true;
+}
+
+// Sizes the view (and the minimap) for the screen and makes room for the canvas
+bool rendererLayout(Renderer *r) {
+    int availRows = r->rows, availCols = r->cols;
+    if (!r->fullMaze) {
+        if (r->screenRows > 0) {
+            availRows = r->screenRows - RENDER_MESSAGE_LINES;
+            availCols = r->screenCols / 2;
+        } else {
+            availRows = availCols = RENDER_PIPE_CELLS;
+        }
+        if (availRows < 5) availRows = 5;
+        if (availCols < 10) availCols = 10;
+    }
+    int mapRows = 0, mapCols = 0;
+    if (r->minimap) {
+        int maxRows = availRows < MINIMAP_ROWS ? availRows : MINIMAP_ROWS;
+        int maxCols = availCols / 4 < MINIMAP_COLS ? availCols / 4 : MINIMAP_COLS;
+        if (maxCols < 1) maxCols = 1;
+        int size = MINIMAP_MIN_BLOCK;
+        if ((r->rows + maxRows - 1) / maxRows > size) size = (r->rows + maxRows - 1) / maxRows;
+        if ((r->cols + maxCols - 1) / maxCols > size) size = (r->cols + maxCols - 1) / maxCols;
+        mapRows = (r->rows + size - 1) / size;
+        mapCols = (r->cols + size - 1) / size;
+        if (!r->fullMaze) availCols -= mapCols + 1;
+        if (r->map.size != size) {
+            if (r->mapGrid) r->mapGrid->summary = NULL;
+            if (!blockSummaryBuild(&r->map, r->mapGrid, size)) return false;
+            r->mapGrid->summary = &r->map;
+        }
+    }
+    r->viewRows = r->rows < availRows ? r->rows : availRows;
+    r->viewCols = r->cols < availCols ? r->cols : availCols;
+    r->canvasRows = r->viewRows > mapRows ? r->viewRows : mapRows;
+    r->canvasCols = r->viewCols + (r->minimap ? mapCols + 1 : 0);
+    r->originX = r->originY = 0;
+    r->valid = false;
+
+    size_t cells = (size_t)r->canvasRows * r->canvasCols;
+    if (cells > r->canvasCap) {
+        char *glyphs = (char *)countedRealloc(r->glyphs, cells);
+        if (glyphs) r->glyphs = glyphs;
+        char *shown = (char *)countedRealloc(r->shown, cells);
+        if (shown) r->shown = shown;
+        if (!glyphs || !shown) return false;
+        r->canvasCap = cells;
+    }
+    return renderReserve(r, (size_t)r->canvasRows * (2 * r->canvasCols + 1) + 64);
+}
+
+bool rendererInit(Renderer *r, int rows, int cols, bool fullMaze) {
+    memset(r, 0, sizeof(*r));
+    r->rows = rows;
+    r->cols = cols;
+    r->fullMaze = fullMaze;
+    r->outFd = STDOUT_FILENO;
+    if (cellGlyphs[0] == 0) buildCellGlyphs();
+
+    r->ansi = isatty(STDOUT_FILENO);
+    struct winsize ws;
+    if (r->ansi && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        r->screenRows = ws.ws_row;
+        r->screenCols = ws.ws_col;
+    }
+    return rendererLayout(r);
+}
+
+// Lays the frame out again for a screen of screenRows x screenCols characters
+bool rendererResize(Renderer *r, int screenRows, int screenCols) {
+    r->screenRows = screenRows;
+    r->screenCols = screenCols;
+    return rendererLayout(r);
+}
+
+// Shows or hides the minimap of g; the block counts are built once and then kept by the grid setters
+bool rendererSetMinimap(Renderer *r, Grid *g, bool on) {
+    if (r->mapGrid) r->mapGrid->summary = NULL;
+    blockSummaryFree(&r->map);
+    r->mapGrid = on ? g : NULL;
+    r->minimap = on;
+    if (rendererLayout(r)) return true;
+    blockSummaryFree(&r->map);
+    g->summary = NULL;
+    r->mapGrid = NULL;
+    r->minimap = false;
+    rendererLayout(r);
+    return false;
+}
+
+// Shows the next maze of a campaign with the same screen buffers, which only grow when the
+// new frame needs more; a shown minimap is counted again for g
+bool rendererSetMaze(Renderer *r, Grid *g) {
+    if (r->mapGrid) r->mapGrid->summary = NULL;
+    r->mapGrid = r->minimap ? g : NULL;
+    r->map.size = 0;
+    r->rows = g->rows;
+    r->cols = g->cols;
+    r->frames = 0;
+    r->totalBytes = 0;
+    r->totalMicros = 0;
+    return rendererLayout(r);
+}
+
+void rendererFree(Renderer *r) {
+    if (r->mapGrid) r->mapGrid->summary = NULL;
+    blockSummaryFree(&r->map);
+    r->mapGrid = NULL;
+    free(r->glyphs);
+    free(r->shown);
+    free(r->out);
+    r->glyphs = r->shown = r->out = NULL;
+}
+
+// Next frame repaints everything (something else drew over the maze)
+void rendererInvalidate(Renderer *r) {
+    r->valid = false;
+}
+
+void renderAppend(Renderer *r, const char *bytes, size_t len) {
+    if (!renderReserve(r, len)) return;
+    memcpy(r->out + r->outLen, bytes, len);
+    r->outLen += len;
+}
+
+// Write the frame buffer in one syscall (stdio is flushed first so nothing interleaves)
+void renderFlush(Renderer *r) {
+    if (r->outFd < 0) return;
+    fflush(stdout);
+    size_t done = 0;
+    while (done < r->outLen) {
+        ssize_t n = write(r->outFd, r->out + done, r->outLen - done);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+}
+
+// Moves the camera only when the player walks into the outer quarter of the view, then centres it
+void rendererFollow(Renderer *r, int playerX, int playerY) {
+    int marginX = r->viewRows / 4, marginY = r->viewCols / 4;
+    int x = r->originX, y = r->originY;
+    if (playerX < x + marginX || playerX >= x + r->viewRows - marginX) x = playerX - r->viewRows / 2;
+    if (playerY < y + marginY || playerY >= y + r->viewCols - marginY) y = playerY - r->viewCols / 2;
+    if (x > r->rows - r->viewRows) x = r->rows - r->viewRows;
+    if (y > r->cols - r->viewCols) y = r->cols - r->viewCols;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x != r->originX || y != r->originY) {
+        r->originX = x;
+        r->originY = y;
+        r->valid = false;    // everything on screen moved
+    }
+}
+
+// One glyph per block: # only walls, : mostly walls, * visited, . open; P and E mark the player and exit
+char minimapGlyph(const Renderer *r, int bx, int by, int playerX, int playerY, int exitX, int exitY) {
+    const BlockSummary *m = &r->map;
+    if (playerX / m->size == bx && playerY / m->size == by) return 'P';
+    if (exitX / m->size == bx && exitY / m->size == by) return 'E';
+    size_t b = (size_t)bx * m->blockCols + by;
+    int h = r->rows - bx * m->size < m->size ? r->rows - bx * m->size : m->size;
+    int w = r->cols - by * m->size < m->size ? r->cols - by * m->size : m->size;
+    if (m->open[b] == 0) return '#';
+    if (m->visited[b] > 0) return '*';
+    return 3 * m->open[b] < (uint32_t)(h * w) ? ':' : '.';
+}
+
+void printMazeGeneric(Renderer *r, const Grid *g, int playerX, int playerY, int exitX, int exitY) {
+    double start = nowMillis();
+    PROFILE_START(profile);
+    int cols = g->cols;
+    rendererFollow(r, playerX, playerY);
+    int rows = r->canvasRows, width = r->canvasCols;
+
+    // base layer (NPCs included) straight from the cell bytes of the view, then the exit and player overlays
+    for (int i = 0; i < r->viewRows; i++) {
+        const unsigned char *cell = g->cells + (size_t)(r->originX + i) * cols + r->originY;
+        char *glyph = r->glyphs + (size_t)i * width;
+        for (int j = 0; j < r->viewCols; j++) glyph[j] = cellGlyphs[cell[j]];
+    }
+    int ex = exitX - r->originX, ey = exitY - r->originY;
+    if (ex >= 0 && ex < r->viewRows && ey >= 0 && ey < r->viewCols) r->glyphs[(size_t)ex * width + ey] = 'E';
+    r->glyphs[(size_t)(playerX - r->originX) * width + playerY - r->originY] = 'P';
+    if (r->minimap) {
+        for (int i = 0; i < rows; i++) {
+            char *glyph = r->glyphs + (size_t)i * width + r->viewCols;
+            *glyph++ = ' ';
+            for (int b = 0; b < r->map.blockCols; b++) {
+                glyph[b] = i < r->map.blockRows ? minimapGlyph(r, i, b, playerX, playerY, exitX, exitY) : ' ';
+            }
+        }
+    }
+
+    r->outLen = 0;
+    bool fits = r->screenRows > 0 && rows + RENDER_MESSAGE_LINES <= r->screenRows;
+    if (r->ansi && fits && r->valid) {
+        // repaint changed cells only, then clear the old status/messages under the maze
+        char seq[32];
+        for (int i = 0; i < rows; i++) {
+            size_t base = (size_t)i * width;
+            for (int j = 0; j < width; j++) {
+                if (r->glyphs[base + j] == r->shown[base + j]) continue;
+                int n = snprintf(seq, sizeof(seq), "\x1b[%d;%dH%c", i + 1, 2 * j + 1, r->glyphs[base + j]);
+                renderAppend(r, seq, n);
+            }
+        }
+        int n = snprintf(seq, sizeof(seq), "\x1b[%d;1H\x1b[J", rows + 1);
+        renderAppend(r, seq, n);
+    } else {
+        if (r->ansi && fits) renderAppend(r, "\x1b[H\x1b[2J", 7);
+        if (renderReserve(r, (size_t)rows * (2 * width + 1))) {
+            char *p = r->out + r->outLen;
+            const char *glyph = r->glyphs;
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < width; j++) {
+                    *p++ = *glyph++;
+                    *p++ = ' ';
+                }
+                *p++ = '\n';
+            }
+            r->outLen = p - r->out;
+        }
+        r->valid = r->ansi && fits;
+    }
+    renderFlush(r);
+    memcpy(r->shown, r->glyphs, (size_t)rows * width);
+
+    r->frames++;
+    r->lastBytes = r->outLen;
+    r->totalBytes += r->outLen;
+    r->lastMicros = (nowMillis() - start) * 1000.0;
+    r->totalMicros += r->lastMicros;
+    PROFILE_STOP(profile, PROF_FRAME);
+}
+
+void printPlayerStatus(Player player) {
+    printf("Player Location: (%d, %d)\n", player.x, player.y);
+    printf("Current Mood: %s\n", moodFaces[player.mood]);
+}
+Mood generateMood(Rng *rng) {
+    return (Mood)rngBelow(rng, 3);
+}
+
+
+void processObstacle(Player *player, int obs,
+                     int *trapCount, int *puzzleCount, int *bonusCount, int rows, int cols) {
+    if (obs == TRAP) {
+        (*trapCount)++;  // count traps
+
+        if (player->mood != HAPPY) {
+            say("You hit a trap! Only Happy players can pass. You lose a turn. Try to cheer up!\n");
+            logLifeLesson("You hit a trap while not happy: sometimes you need inner strength before facing certain challenges.");
+            player->mood = SAD;
+        } else {
+            say("You happily avoided the trap!\n");
+            logLifeLesson("You avoided a trap while happy: good moods can help you navigate problems more lightly.");
+        }
+
+    } else if (obs == PUZZLE) {
+        (*puzzleCount)++;  // count puzzles
+
+        say("You found a puzzle! It alters your mood.\n");
+        logLifeLesson("You faced a puzzle: complex situations can shift how you feel and think.");
+        player->mood = (player->mood + 1) % 3;
+
+    } else if (obs == POWERUP) {
+    say("You found a power-up tile!\n");
+
+    if (player->mood == HAPPY) {
+        say("Your joy unlocks a shortcut somewhere in the maze.\n");
+        logLifeLesson("Happiness unlocked new paths: positive states can reveal hidden options.");
+    } else if (player->mood == SAD) {
+        say("In sadness, the maze feels heavier.\n");
+        logLifeLesson("Sadness closed some paths: sometimes our mood narrows our vision.");
+    } else {
+        say("Neutral mind, neutral maze: nothing changes, yet.\n");
+        logLifeLesson("Neutrality kept the maze steady: not every moment needs change.");
+    }
+} else if (obs == BONUS) {
+        (*bonusCount)++;  // count bonuses
+
+        say("You found a bonus! Your mood is now Happy!\n");
+        logLifeLesson("You found a bonus: good surprises can flip a bad day into a brighter one.");
+        player->mood = HAPPY;
+    }
+    
+}
+
+// Records a reflection answer into the session's key log (if one is open)
+void keyLogText(const char *text);
+
+// Randomly show either a philosophical quote or a small exercise
+void showRandomPhilosophySupport(Rng *rng) {
+    int r = rngBelow(rng, 2); // 0 quote, 1 exercise
+    if (r == 0) {
+        int idx = rngBelow(rng, NUM_QUOTES);
+        printf("\n--- Philosophical Quote ---\n");
+        printf("%s\n", philosophyQuotes[idx]);
+        printf("----------------------------\n");
+    } else {
+        int idx = rngBelow(rng, NUM_EXERCISES);
+        printf("\n--- Philosophical Exercise ---\n");
+        printf("%s\n", philosophyExercises[idx]);
+        printf("\nDo you want to answer this? (y/n): ");
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF) {} // clear leftover
+        char choice = getchar();
+        if (choice == 'y' || choice == 'Y') {
+            char answer[256];
+            while ((c = getchar()) != '\n' && c != EOF) {} // clear line
+            printf("Your reflection: ");
+            if (fgets(answer, sizeof(answer), stdin)) {
+                answer[strcspn(answer, "\n")] = 0;
+                keyLogText(answer);
+                // simple response
+                printf("\nThanks for sharing. Even small reflections can change how you move in the maze and in life.\n");
+                logLifeLesson("Player completed a philosophical exercise and reflected on their journey.");
+            }
+        } else {
+            printf("That's okay. Not every question needs an answer right now.\n");
+        }
+        printf("----------------------------\n");
+    }
+}
+
+//Maze wall is changed based on player's mood, reach (may be NULL) keeps the exit reachable
+void morphMaze(Grid *g, CellIndex *idx, Reach *reach, int morphAmount, Player player, Rng *rng) {
+    PROFILE_START(profile);
+    int playerCell = player.x * g->cols + player.y;
+    for (int n = 0; n < morphAmount; n++) {
+        // Mood-based rule, drawn straight from the index:
+        // SAD  -> more openings (a random wall)
+        // HAPPY-> more walls, slightly harder (a random path)
+        // NEUTRAL -> random toggle (any cell)
+        int c;
+        if (player.mood == SAD) c = cellIndexRandomClosed(idx, rng);
+        else if (player.mood == HAPPY) c = cellIndexRandomOpen(idx, rng);
+        else c = rngBelow(rng, idx->total);
+        if (c < 0) continue;
+        int i = c / g->cols, j = c % g->cols;
+
+        if (gridHasFlag(g, i, j, CELL_PRESERVE)) continue; // not to touch protected cells
+        if (player.x == i && player.y == j) continue;   // not to trap player
+
+        bool opening = !gridIsOpen(g, i, j);
+        cellIndexSetOpen(idx, g, i, j, opening);
+        if (!reach) continue;
+        if (opening) {
+            reachOnOpen(reach, g, c);
+        } else {
+            bool wasReachable = reach->dist[playerCell] != REACH_INF;
+            reachOnClose(reach, g, c);
+            // the route is protected, so this should never fire; undo the toggle if it does
+            if (wasReachable && reach->dist[playerCell] == REACH_INF) {
+                cellIndexSetOpen(idx, g, i, j, true);
+                reachOnOpen(reach, g, c);
+            }
+        }
+    }
+    if (reach) reachUpdateRoute(reach, g, player.x, player.y);
+
+    // Move one random obstacle onto a random path tile
+    int c = cellIndexRandomOpen(idx, rng);
+    if (c >= 0) {
+        int oi = c / g->cols, oj = c % g->cols;
+        if (!gridHasFlag(g, oi, oj, CELL_PRESERVE) && !(player.x == oi && player.y == oj)) {
+            gridSetObstacle(g, oi, oj, rngBelow(rng, 3) + 1); // TRAP, PUZZLE, BONUS
+        }
+    }
+    PROFILE_STOP(profile, PROF_MORPH);
+}
+
+// --- Par solver ---
+// Fewest steps from a cell to the exit using the moves main allows: a step onto an open
+// neighbour, or 'j' over one wall tile without an obstacle onto the open tile behind it.
+// Facing a direction is free (bumping a wall sets lastMove without a step), so every jump
+// costs exactly one step and plain BFS is exact. Jump-point search gains nothing in
+// one-wide corridors, and A* has no useful heuristic once a jump covers two cells.
+// BFS runs level by level through one queue with CELL_SCRATCH as the visited mark; the
+// queue doubles as the list of marked cells, so clearing costs only the cells reached.
+typedef struct {
+    int *queue;           // cells reached by the last solve, in the order they were reached
+    int cap;
+    long visited;         // cells reached by the last solve
+    double lastMicros;    // time taken by the last solve
+} Solver;
+
+void solverFree(Solver *s) {
+    free(s->queue);
+    *s = (Solver){0};
+}
+
+// Queues c for the next level unless it is a wall or already reached, false when out of memory
+static inline bool solverVisit(Solver *s, Grid *g, int c, int *count) {
+    if ((g->cells[c] & (CELL_OPEN | CELL_SCRATCH)) != CELL_OPEN) return true;
+    if (*count == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 1024;
+        int *queue = (int *)countedRealloc(s->queue, (size_t)cap * sizeof(int));
+        if (!queue) return false;
+        s->queue = queue;
+        s->cap = cap;
+    }
+    g->cells[c] |= CELL_SCRATCH;
+    s->queue[(*count)++] = c;
+    return true;
+}
+
+// Optimal step count from (fromX, fromY) to the exit, -1 if there is no way
+int solveMaze(Solver *s, Grid *g, int fromX, int fromY, int exitX, int exitY) {
+    double start = nowMillis();
+    PROFILE_START(profile);
+    int cols = g->cols, target = exitX * cols + exitY;
+    int result = -1, head = 0, count = 0;
+    bool ok = solverVisit(s, g, fromX * cols + fromY, &count);
+    for (int level = 0; ok && head < count && result < 0; level++) {
+        for (int end = count; head < end && ok; head++) {
+            int u = s->queue[head];
+            if (u == target) {
+                result = level;
+                break;
+            }
+            int x = u / cols, y = u % cols;
+            for (int d = 0; d < 4 && ok; d++) {
+                int nx = x + DX[d], ny = y + DY[d];
+                if (!gridInBounds(g, nx, ny)) continue;
+                if (gridIsOpen(g, nx, ny)) {
+                    ok = solverVisit(s, g, nx * cols + ny, &count);
+                } else if (gridObstacle(g, nx, ny) == NONE && gridInBounds(g, nx + DX[d], ny + DY[d])) {
+                    ok = solverVisit(s, g, (nx + DX[d]) * cols + ny + DY[d], &count);
+                }
+            }
+        }
+    }
+    if (!ok) printf("Not enough memory for the solver.\n");
+
+    for (int k = 0; k < count; k++) g->cells[s->queue[k]] &= (unsigned char)~CELL_SCRATCH;
+    s->visited = count;
+    s->lastMicros = (nowMillis() - start) * 1000.0;
+    PROFILE_STOP(profile, PROF_SOLVE);
+    return ok ? result : -1;
+}
+
+// Morphs the maze and re-solves par on the result: the fewest steps from the start, where every
+// run begins, to the exit, and never less than the player still needs from where they stand.
+// A morph that opened or closed nothing the solver reads leaves par as it was.
+void morphMazeWithPar(Grid *g, CellIndex *idx, Reach *reach, Solver *solver, int morphAmount,
+                      Player player, int exitX, int exitY, int *par, Rng *rng) {
+    uint32_t version = g->version;
+    morphMaze(g, idx, reach, morphAmount, player, rng);
+    if (g->version == version) return;
+    int fromStart = solveMaze(solver, g, 0, 0, exitX, exitY);
+    int remaining = player.x == 0 && player.y == 0 ? fromStart
+                                                   : solveMaze(solver, g, player.x, player.y, exitX, exitY);
+    if (remaining > fromStart) fromStart = remaining;
+    if (fromStart >= 0) *par = fromStart;   // out of memory: keep the last par
+}
+
+// --- NPC spatial index ---
+// Active NPCs are chained per 8x8 block of cells. CELL_NPC in the grid answers
+// "is anyone on this tile?" in O(1); the block chain is only walked when it says yes.
+#define NPC_BUCKET_SHIFT 3
+
+typedef struct {
+    NPC *npcs;
+    int count;
+    int bucketCols;
+    int *heads;        // first NPC of each block, -1 if none
+} NPCIndex;
+
+bool npcIndexInit(NPCIndex *idx, int npcCount, int rows, int cols, Arena *arena) {
+    int bucketRows = (rows >> NPC_BUCKET_SHIFT) + 1;
+    idx->count = npcCount;
+    idx->bucketCols = (cols >> NPC_BUCKET_SHIFT) + 1;
+    idx->npcs = (NPC *)levelCalloc(arena, npcCount > 0 ? npcCount : 1, sizeof(NPC));
+    idx->heads = (int *)levelAlloc(arena, (size_t)bucketRows * idx->bucketCols * sizeof(int));
+    if (!idx->npcs || !idx->heads) return false;
+    memset(idx->heads, 0xFF, (size_t)bucketRows * idx->bucketCols * sizeof(int));   // all -1
+    return true;
+}
+
+void npcIndexFree(NPCIndex *idx) {
+    free(idx->npcs);
+    free(idx->heads);
+    idx->npcs = NULL;
+    idx->heads = NULL;
+}
+
+static inline int npcBucket(const NPCIndex *idx, int x, int y) {
+    return (x >> NPC_BUCKET_SHIFT) * idx->bucketCols + (y >> NPC_BUCKET_SHIFT);
+}
+
+void npcIndexInsert(NPCIndex *idx, Grid *g, int i) {
+    NPC *npc = &idx->npcs[i];
+    int *head = &idx->heads[npcBucket(idx, npc->x, npc->y)];
+    npc->prev = -1;
+    npc->next = *head;
+    if (*head >= 0) idx->npcs[*head].prev = i;
+    *head = i;
+    gridSetFlag(g, npc->x, npc->y, CELL_NPC);
+}
+
+// First active NPC standing on (x, y), or -1
+int npcFirstAt(const NPCIndex *idx, const Grid *g, int x, int y) {
+    if (!gridHasFlag(g, x, y, CELL_NPC)) return -1;
+    for (int i = idx->heads[npcBucket(idx, x, y)]; i >= 0; i = idx->npcs[i].next) {
+        if (idx->npcs[i].x == x && idx->npcs[i].y == y) return i;
+    }
+    return -1;
+}
+
+// Unlink an NPC that went inactive, the tile loses CELL_NPC once nobody else is on it
+void npcIndexRemove(NPCIndex *idx, Grid *g, int i) {
+    NPC *npc = &idx->npcs[i];
+    if (npc->prev >= 0) idx->npcs[npc->prev].next = npc->next;
+    else idx->heads[npcBucket(idx, npc->x, npc->y)] = npc->next;
+    if (npc->next >= 0) idx->npcs[npc->next].prev = npc->prev;
+    npc->next = npc->prev = -1;
+    for (int k = idx->heads[npcBucket(idx, npc->x, npc->y)]; k >= 0; k = idx->npcs[k].next) {
+        if (idx->npcs[k].x == npc->x && idx->npcs[k].y == npc->y) return;
+    }
+    *gridCell(g, npc->x, npc->y) &= ~CELL_NPC;
+}
+
+// Take every NPC off the grid (before re-placing them or dropping the index)
+void npcIndexClear(NPCIndex *idx, Grid *g) {
+    for (int i = 0; i < idx->count; i++) {
+        if (idx->npcs[i].active) {
+            idx->npcs[i].active = false;
+            npcIndexRemove(idx, g, i);
+        }
+    }
+}
+
+// messages by type
+void npcSetMessages(NPC *npc) {
+    if (npc->type == MENTOR) {
+        npc->msgHappy   = "Mentor: You’re glowing today. Use this energy wisely.";
+        npc->msgNeutral = "Mentor: Even small steps count. Keep going.";
+        npc->msgSad     = "Mentor: It’s okay to move slowly. Just don’t stop.";
+    } else if (npc->type == SHADOW) {
+        npc->msgHappy   = "Shadow: Are you sure this happiness isn’t just a mask?";
+        npc->msgNeutral = "Shadow: Silence is loud, isn’t it?";
+        npc->msgSad     = "Shadow: I know the dark corners. But they’re not all you are.";
+    } else { // SAGE
+        npc->msgHappy   = "Sage: Joy is also data. Notice what makes it arise.";
+        npc->msgNeutral = "Sage: Observe your mind like a sky, not the clouds.";
+        npc->msgSad     = "Sage: Pain is a teacher. What is it asking you to see?";
+    }
+}
+
+void initNPCs(NPCIndex *idx, Grid *g, const CellIndex *cells, Rng *rng) {
+    PROFILE_START(profile);
+    NPC *npcs = idx->npcs;
+    npcIndexClear(idx, g);
+    // positions picked randomly on paths, archetypes take turns
+    for (int i = 0; i < idx->count; i++) {
+        npcs[i].type = (NPCType)(i % 3);
+        npcs[i].active = true;
+
+        // to place on a random path tile other than the start
+        int c = cellIndexRandomOpen(cells, rng);
+        while (c == 0 && cells->openCount > 1) c = cellIndexRandomOpen(cells, rng);
+        if (c < 0) c = 0;
+        npcs[i].x = c / g->cols;
+        npcs[i].y = c % g->cols;
+        npcIndexInsert(idx, g, i);
+        npcSetMessages(&npcs[i]);
+    }
+    PROFILE_STOP(profile, PROF_NPCS);
+}
+
+// NPC talks based on mood and stats, later, asks for reflection line
+void speakWithNPC(NPC *npc, Player *player,
+                  int steps,
+                  int trapCount, int puzzleCount, int philosophyUses);
+
+// Base line depending on archetype & mood
+const char *npcGreeting(const NPC *npc, const Player *player) {
+    if (player->mood == HAPPY) return npc->msgHappy;
+    if (player->mood == NEUTRAL) return npc->msgNeutral;
+    return npc->msgSad;
+}
+
+//Check if player is on an NPC tile and trigger the encounter once, returns how many NPCs spoke
+int checkNPCEncounter(Player *player, NPCIndex *idx, Grid *g, int steps, int trapCount, int puzzleCount, int philosophyUses) {
+    int met = 0;
+    int i;
+    while ((i = npcFirstAt(idx, g, player->x, player->y)) >= 0) {
+        if (serving) say("\n--- NPC Encounter ---\n%s\n", npcGreeting(&idx->npcs[i], player));
+        else if (!headless) speakWithNPC(&idx->npcs[i], player, steps, trapCount, puzzleCount, philosophyUses);
+        logLifeLesson("You met an archetype in the maze: guidance appears in many forms when you keep moving.");
+        idx->npcs[i].active = false;
+        npcIndexRemove(idx, g, i);
+        met++;
+    }
+    return met;
+}
+
+
+// --- Journal viewer ---
+// The journal and its index mapped read-only, entry k is entries[k]. Opening costs two
+// mmaps however long the journal is (plus indexing whatever the index has not seen yet).
+typedef struct {
+    const char *text;
+    size_t textSize;
+    const JournalIndexEntry *entries;
+    long count;
+    size_t indexSize;
+} JournalView;
+
+void journalViewClose(JournalView *v) {
+    if (v->text) munmap((void *)v->text, v->textSize);
+    if (v->entries) munmap((void *)((const char *)v->entries - sizeof(JournalIndexHeader)), v->indexSize);
+    *v = (JournalView){0};
+}
+
+// Maps a file read-only, NULL if it is missing or empty
+const void *mapFile(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size = (size_t)st.st_size;
+        map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+bool journalViewOpen(JournalView *v, const char *path) {
+    *v = (JournalView){0};
+    uint32_t lastSession;
+    long long indexed = journalIndexCatchUp(path, NULL, &lastSession);
+    if (indexed <= 0) return false;
+    char indexPath[512];
+    journalIndexPath(indexPath, sizeof(indexPath), path);
+    v->text = (const char *)mapFile(path, &v->textSize);
+    const char *index = (const char *)mapFile(indexPath, &v->indexSize);
+    if (index) v->entries = (const JournalIndexEntry *)(index + sizeof(JournalIndexHeader));
+    if (!v->text || !index || v->textSize < (size_t)indexed) {
+        journalViewClose(v);
+        return false;
+    }
+    v->count = (long)((v->indexSize - sizeof(JournalIndexHeader)) / sizeof(JournalIndexEntry));
+    return true;
+}
+
+// First entry of a session (or of the next one, if it wrote nothing)
+long journalViewSessionStart(const JournalView *v, uint32_t session) {
+    long lo = 0, hi = v->count;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        if (v->entries[mid].session < session) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Entries that point past the end of the journal (cut or edited behind the index's back)
+// are not read, only reported
+void journalViewPrint(const JournalView *v, long first, long count) {
+    if (first < 0) first = 0;
+    for (long k = first; k < first + count && k < v->count; k++) {
+        const JournalIndexEntry *e = &v->entries[k];
+        if (e->offset > v->textSize || e->length > v->textSize - e->offset) {
+            printf("- (entry %ld is past the end of the journal; delete %s.idx to index it again)\n", k + 1,
+                   journalFile);
+            continue;
+        }
+        printf("- %.*s\n", (int)e->length, v->text + e->offset);
+    }
+}
+
+// Pages through the journal, newest entries first. o/n move a page, "s N" jumps to
+// session N (this run without N), "p N" to page N, anything else goes back to the maze.
+void showJournal() {
+    journalFlush(&journal);   // show what is still queued too
+    JournalView v;
+    if (!journalViewOpen(&v, journalFile) || v.count == 0) {
+        printf("\nNo journal entries yet. Go live a little in the maze first.\n");
+        journalViewClose(&v);
+        return;
+    }
+
+    skipInputLine(); // clear leftover input
+    long first = v.count > JOURNAL_PAGE ? v.count - JOURNAL_PAGE : 0;
+    for (;;) {
+        long shown = v.count - first < JOURNAL_PAGE ? v.count - first : JOURNAL_PAGE;
+        printf("\n===== Life Lessons Journal (entries %ld-%ld of %ld, session %u) =====\n",
+               first + 1, first + shown, v.count, v.entries[first].session);
+        journalViewPrint(&v, first, JOURNAL_PAGE);
+        printf("================================\n");
+        printf("[o]lder, [n]ewer, [s N] session, [p N] page, Enter to go back: ");
+        char line[64];
+        long arg = 0;
+        if (!fgets(line, sizeof(line), stdin)) break;
+        bool hasArg = sscanf(line + 1, "%ld", &arg) == 1;
+        if (line[0] == 'o') first -= JOURNAL_PAGE;
+        else if (line[0] == 'n') first += JOURNAL_PAGE;
+        else if (line[0] == 's') first = journalViewSessionStart(&v, hasArg ? (uint32_t)arg : journal.session);
+        else if (line[0] == 'p' && hasArg) first = (arg - 1) * JOURNAL_PAGE;
+        else break;
+        if (first > v.count - 1) first = v.count - 1;
+        if (first < 0) first = 0;
+    }
+    printf("\n");
+    journalViewClose(&v);
+}
+
+// --journal-view last:N | session:N | page:N prints that part of the journal and exits
+bool printJournalView(const char *spec) {
+    JournalView v;
+    if (!journalViewOpen(&v, journalFile)) {
+        printf("No journal entries yet.\n");
+        return true;
+    }
+    long n = JOURNAL_PAGE;
+    const char *colon = strchr(spec, ':');
+    if (colon) n = atol(colon + 1);
+    bool ok = true;
+    if (strncmp(spec, "last", 4) == 0) {
+        journalViewPrint(&v, v.count - n, n);
+    } else if (strncmp(spec, "session", 7) == 0) {
+        long first = journalViewSessionStart(&v, (uint32_t)n);
+        journalViewPrint(&v, first, journalViewSessionStart(&v, (uint32_t)n + 1) - first);
+    } else if (strncmp(spec, "page", 4) == 0 && n > 0) {
+        journalViewPrint(&v, (n - 1) * JOURNAL_PAGE, JOURNAL_PAGE);
+    } else {
+        printf("Unknown journal view: %s (use last:N, session:N or page:N)\n", spec);
+        ok = false;
+    }
+    printf("(%ld entries, last session %u, in %s)\n", v.count, v.count > 0 ? v.entries[v.count - 1].session : 0, journalFile);
+    journalViewClose(&v);
+    return ok;
+}
+
+// Generate maze based on chosen level (size grows with level)
+// Place mood-based NPC archetypes
+// Handle traps/puzzles/bonuses and log "life lessons"
+
+int levelToSize(int level) {
+    if (level < 1) level = 1;
+    if (level > 50) level = 50;        // levels 1–50
+
+    int size = 9 + level * 2;         
+    return size;
+}
+
+
+
+
+
+void speakWithNPC(NPC *npc, Player *player,
+                  int steps,
+                  int trapCount, int puzzleCount, int philosophyUses) {
+    printf("\n--- NPC Encounter ---\n");
+
+    // Base line depending on archetype & mood
+    printf("%s\n", npcGreeting(npc, player));
+
+    // comments based on stats
+    if (steps > 150) {
+        printf("NPC: You've been wandering a long time... what keeps you going?\n");
+    }
+    if (trapCount > 0) {
+        printf("NPC: I see you've survived some traps. What did they teach you?\n");
+    }
+    if (philosophyUses >= 3) {
+        printf("NPC: You seek wisdom often. That curiosity is your true power.\n");
+    }
+
+    printf("NPC: Before you go, answer this in one line:\n");
+    printf("     What is one thing you learned in this maze so far?\n");
+
+    char answer[256];
+    skipInputLine(); // clear leftover
+    printf("Your reflection: ");
+    fflush(stdout);
+    if (readTextLine(answer, sizeof(answer))) {
+        keyLogText(answer);
+        printf("NPC: Thank you. Even small reflections change how you move.\n");
+        logLifeLesson("NPC reflection from player:");
+        logLifeLesson(answer);
+    }
+    printf("----------------------\n");
+}
+void askEndOfSessionReflection() {
+    printf("\nDo you want to write a short reflection about this run? (y/n): ");
+
+    int c;
+    skipInputLine(); // clear leftover input
+    char choice = getchar();
+
+    if (choice == 'y' || choice == 'Y') {
+        char line[256];
+        while ((c = getchar()) != '\n' && c != EOF) {} // clear line
+        printf("Write your reflection (one line): ");
+        if (fgets(line, sizeof(line), stdin)) {
+            line[strcspn(line, "\n")] = 0; // remove newline
+            keyLogText(line);
+
+            char entry[300];
+            snprintf(entry, sizeof(entry), "[End-of-session reflection] %s", line);
+            logLifeLesson(entry);
+            printf("Reflection saved to journal.\n");
+        }
+    } else {
+        printf("No reflection this time. That’s okay.\n");
+    }
+}
+
+
+void waitForEnter() {
+    printf("\nPress Enter to continue...\n");
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {} // clear line
+}
+
+
+// --- Session stats ---
+// session_stats.bin holds a "PSYMSTA1" header and then one fixed 64-byte StatsRecord per
+// finished run, appended as the run ends. A query maps the file and splits the records
+// between threads; each thread counts steps into its own per-level histograms (exact below
+// STATS_STEP_BINS, longer runs listed apart) and XP values, and the counts are merged at the end.
+#define STATS_FILE "session_stats.bin"
+#define STATS_MAGIC "PSYMSTA1"
+#define STATS_LEVELS 50
+#define STATS_STEP_BINS 4096
+#define STATS_XP_MAX 135          // every achievement in one run
+
+typedef struct {
+    char magic[8];
+    uint32_t recordSize;      // sizeof(StatsRecord) of the build that wrote the file
+    uint32_t reserved;
+} StatsHeader;
+
+typedef struct {
+    uint64_t seed;
+    int64_t timestamp;
+    int32_t level, playerLevel;     // maze level and player level after the run
+    int32_t steps, par, xp;
+    int32_t moodCounts[3];
+    int32_t trapCount, puzzleCount, bonusCount, philosophyUses;
+} StatsRecord;
+
+// Appends one run to the store, writing the header first if the file is new
+void statsAppend(const char *filename, const StatsRecord *record) {
+    FILE *f = fopen(filename, "ab");
+    if (!f) {
+        printf("Could not open stats file.\n");
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0) {
+        StatsHeader header = {STATS_MAGIC, sizeof(StatsRecord), 0};
+        fwrite(&header, sizeof(header), 1, f);
+    }
+    if (fwrite(record, sizeof(*record), 1, f) != 1) printf("Could not write session stats.\n");
+    fclose(f);
+}
+
+typedef struct {
+    long runs;
+    long long stepSum;
+    int minSteps, maxSteps;
+    int *longRuns;            // step counts of STATS_STEP_BINS and up
+    long longCount, longCap;
+    bool longSorted;
+} StatsLevel;
+
+typedef struct {
+    StatsLevel levels[STATS_LEVELS + 1];    // 0 collects records with a level outside 1-50
+    uint32_t *bins;                         // STATS_STEP_BINS step counts per level
+    long xp[STATS_XP_MAX + 1];
+    long long xpSum;
+    long runs;
+} StatsSummary;
+
+bool statsSummaryInit(StatsSummary *s) {
+    memset(s, 0, sizeof(*s));
+    s->bins = (uint32_t *)countedCalloc((size_t)(STATS_LEVELS + 1) * STATS_STEP_BINS, sizeof(uint32_t));
+    return s->bins != NULL;
+}
+
+void statsSummaryFree(StatsSummary *s) {
+    for (int l = 0; l <= STATS_LEVELS; l++) free(s->levels[l].longRuns);
+    free(s->bins);
+    memset(s, 0, sizeof(*s));
+}
+
+static bool statsAddLongRun(StatsLevel *level, int steps) {
+    if (level->longCount == level->longCap) {
+        long cap = level->longCap ? level->longCap * 2 : 256;
+        int *runs = (int *)countedRealloc(level->longRuns, (size_t)cap * sizeof(int));
+        if (!runs) return false;
+        level->longRuns = runs;
+        level->longCap = cap;
+    }
+    level->longRuns[level->longCount++] = steps;
+    return true;
+}
+
+// Counts records [0, count) into s, false if a long-run list could not grow
+bool statsCount(StatsSummary *s, const StatsRecord *records, long count) {
+    bool ok = true;
+    for (long i = 0; i < count; i++) {
+        const StatsRecord *r = &records[i];
+        int l = (unsigned)(r->level - 1) < STATS_LEVELS ? r->level : 0;
+        StatsLevel *level = &s->levels[l];
+        int steps = r->steps > 0 ? r->steps : 0;
+        if (level->runs == 0 || steps < level->minSteps) level->minSteps = steps;
+        if (level->runs == 0 || steps > level->maxSteps) level->maxSteps = steps;
+        level->runs++;
+        level->stepSum += steps;
+        if (steps < STATS_STEP_BINS) s->bins[(size_t)l * STATS_STEP_BINS + steps]++;
+        else ok &= statsAddLongRun(level, steps);
+        int xp = r->xp < 0 ? 0 : r->xp > STATS_XP_MAX ? STATS_XP_MAX : r->xp;
+        s->xp[xp]++;
+        s->xpSum += r->xp;
+    }
+    s->runs += count;
+    return ok;
+}
+
+// Adds the counts of from into into
+bool statsMerge(StatsSummary *into, const StatsSummary *from) {
+    bool ok = true;
+    for (size_t b = 0; b < (size_t)(STATS_LEVELS + 1) * STATS_STEP_BINS; b++) into->bins[b] += from->bins[b];
+    for (int l = 0; l <= STATS_LEVELS; l++) {
+        StatsLevel *a = &into->levels[l];
+        const StatsLevel *b = &from->levels[l];
+        if (b->runs == 0) continue;
+        if (a->runs == 0 || b->minSteps < a->minSteps) a->minSteps = b->minSteps;
+        if (a->runs == 0 || b->maxSteps > a->maxSteps) a->maxSteps = b->maxSteps;
+        a->runs += b->runs;
+        a->stepSum += b->stepSum;
+        for (long k = 0; k < b->longCount; k++) ok &= statsAddLongRun(a, b->longRuns[k]);
+    }
+    for (int x = 0; x <= STATS_XP_MAX; x++) into->xp[x] += from->xp[x];
+    into->xpSum += from->xpSum;
+    into->runs += from->runs;
+    return ok;
+}
+
+typedef struct {
+    const StatsRecord *records;
+    long count;
+    StatsSummary summary;
+    bool ok, spawned;
+} StatsWorker;
+
+static void *statsWorker(void *arg) {
+    StatsWorker *w = (StatsWorker *)arg;
+    w->ok = statsCount(&w->summary, w->records, w->count);
+    return NULL;
+}
+
+// Counts count records into out on threads threads (0 = every core)
+bool statsScan(const StatsRecord *records, long count, int threads, StatsSummary *out) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (count < (long)threads * 65536) threads = (int)(count / 65536) + 1;   // not worth a thread
+    if (!statsSummaryInit(out)) return false;
+    StatsWorker *workers = (StatsWorker *)countedCalloc(threads, sizeof(StatsWorker));
+    pthread_t *ids = (pthread_t *)countedCalloc(threads, sizeof(pthread_t));
+    int ready = 0;
+    while (workers && ids && ready < threads && statsSummaryInit(&workers[ready].summary)) ready++;
+    bool ok = ready == threads;
+    for (int w = 0; ok && w < threads; w++) {
+        long from = count * w / threads, to = count * (w + 1) / threads;
+        workers[w].records = records + from;
+        workers[w].count = to - from;
+        workers[w].spawned = w > 0 && pthread_create(&ids[w], NULL, statsWorker, &workers[w]) == 0;
+    }
+    // worker 0 and any that could not start run here
+    for (int w = 0; ok && w < threads; w++) {
+        if (!workers[w].spawned) statsWorker(&workers[w]);
+    }
+    for (int w = 0; ok && w < threads; w++) {
+        if (workers[w].spawned) pthread_join(ids[w], NULL);
+    }
+    for (int w = 0; ok && w < threads; w++) ok = workers[w].ok && statsMerge(out, &workers[w].summary);
+    for (int w = 0; w < ready; w++) statsSummaryFree(&workers[w].summary);
+    free(ids);
+    free(workers);
+    if (!ok) statsSummaryFree(out);
+    return ok;
+}
+
+static int compareInts(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile (0 < p <= 1) of the steps of level l
+int statsPercentile(StatsSummary *s, int l, double p) {
+    StatsLevel *level = &s->levels[l];
+    long rank = (long)(p * level->runs);
+    if (rank < p * level->runs || rank < 1) rank++;
+    const uint32_t *bins = s->bins + (size_t)l * STATS_STEP_BINS;
+    long seen = 0;
+    for (int steps = 0; steps < STATS_STEP_BINS; steps++) {
+        seen += bins[steps];
+        if (seen >= rank) return steps;
+    }
+    // the rank falls among the long runs, sorted once on first use
+    if (!level->longSorted) {
+        qsort(level->longRuns, level->longCount, sizeof(int), compareInts);
+        level->longSorted = true;
+    }
+    return level->longRuns[rank - seen - 1];
+}
+
+// XP per run in buckets of 10 with an ASCII bar each
+void printXPDistribution(const StatsSummary *s) {
+    if (s->runs == 0) return;
+    printf("\nXP per run (mean %.1f):\n", (double)s->xpSum / s->runs);
+    long buckets[STATS_XP_MAX / 10 + 1] = {0}, most = 1;
+    for (int x = 0; x <= STATS_XP_MAX; x++) buckets[x / 10] += s->xp[x];
+    for (int b = 0; b <= STATS_XP_MAX / 10; b++) if (buckets[b] > most) most = buckets[b];
+    for (int b = 0; b <= STATS_XP_MAX / 10; b++) {
+        if (buckets[b] == 0) continue;
+        printf("%3d-%3d %6.2f%% ", b * 10, b * 10 + 9, 100.0 * buckets[b] / s->runs);
+        for (long i = 0; i < (buckets[b] * 40 + most - 1) / most; i++) printf("*");
+        printf("\n");
+    }
+}
+
+// Maps a stats file and prints steps per level and the XP distribution, --stats.
+// Records cut short by a crash at the end of the file are left out.
+bool printStats(const char *filename, int threads) {
+    double start = nowMillis();
+    size_t size = 0;
+    const unsigned char *map = (const unsigned char *)mapFile(filename, &size);
+    if (!map) {
+        printf("No session stats in %s yet.\n", filename);
+        return false;
+    }
+    const StatsHeader *header = (const StatsHeader *)map;
+    if (size < sizeof(*header) || memcmp(header->magic, STATS_MAGIC, 8) != 0 ||
+        header->recordSize != sizeof(StatsRecord)) {
+        printf("%s is not a session stats file.\n", filename);
+        munmap((void *)map, size);
+        return false;
+    }
+    long count = (long)((size - sizeof(*header)) / sizeof(StatsRecord));
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+    StatsSummary s;
+    if (!statsScan((const StatsRecord *)(map + sizeof(*header)), count, threads, &s)) {
+        printf("Not enough memory for the stats query.\n");
+        munmap((void *)map, size);
+        return false;
+    }
+    double millis = nowMillis() - start;
+
+    printf("===== SESSION STATS: %ld runs in %s (%.1f ms) =====\n", s.runs, filename, millis);
+    printf("Level      Runs   Mean steps    p50    p99    Min    Max\n");
+    for (int l = 1; l <= STATS_LEVELS + 1; l++) {
+        int index = l <= STATS_LEVELS ? l : 0;    // unknown levels last
+        StatsLevel *level = &s.levels[index];
+        if (level->runs == 0) continue;
+        if (index > 0) printf("%5d", l);
+        else printf("other");
+        printf(" %9ld %12.1f %6d %6d %6d %6d\n", level->runs, (double)level->stepSum / level->runs,
+               statsPercentile(&s, index, 0.5), statsPercentile(&s, index, 0.99), level->minSteps, level->maxSteps);
+    }
+    printXPDistribution(&s);
+    statsSummaryFree(&s);
+    munmap((void *)map, size);
+    return true;
+}
+
+// Prints the achievements of a run (silent when headless) and returns the XP they are worth
+int showAchievementsAndComputeXP(int steps, int par,
+                                 int moodCounts[3],
+                                 int trapCount, int puzzleCount, int bonusCount,
+                                 int philosophyUses) {
+    int xp = 0;
+
+    say("\n===== ACHIEVEMENTS =====\n");
+
+    // par stays -1 when the first solve found no way to the exit or ran out of memory
+    if (par <= 0) {
+        say("Par unavailable, efficiency not scored\n");
+    } else if (steps * 4 <= par * 5) {
+        say("Efficient Explorer (finished within 125%% of par)\n");
+        xp += 30;
+    } else if (steps > par * 3) {
+        say("Persistent Wanderer (kept going despite a long path)\n");
+        xp += 20;
+    }
+
+    if (moodCounts[HAPPY] > moodCounts[SAD]) {
+        say("Bringer of Light (more happy moods than sad)\n");
+        xp += 20;
+    }
+
+    if (philosophyUses >= 3) {
+        say("Reflective Seeker (used philosophy support 3+ times)\n");
+        xp += 25;
+    }
+
+    if (puzzleCount >= 2) {
+        say("Riddle Breaker (solved multiple puzzles)\n");
+        xp += 15;
+    }
+
+    if (trapCount == 0) {
+        say("Untouched by Traps (avoided all traps)\n");
+        xp += 30;
+    }
+
+    if (trapCount > 0 && moodCounts[SAD] > 0) {
+        say("Resilient Soul (kept going despite traps and sadness)\n");
+        xp += 15;
+    }
+
+    say("Total XP this run: %d\n", xp);
+    say("========================\n");
+
+    return xp;
+}
+
+void savePlayerLevel(const char *filename, int level) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        printf("Could not save player level.\n");
+        return;
+    }
+    fprintf(f, "%d\n", level);
+    fclose(f);
+}
+
+// Medals are scored against par, the solver's optimal step count for this maze
+typedef enum { MEDAL_GOLD, MEDAL_SILVER, MEDAL_BRONZE, MEDAL_EXPLORER, MEDAL_NONE } Medal;
+
+// MEDAL_NONE when there is no par to score against
+Medal speedrunMedal(int steps, int par) {
+    if (par <= 0) return MEDAL_NONE;
+    if (steps * 10 <= par * 11) return MEDAL_GOLD;
+    if (steps * 2 <= par * 3) return MEDAL_SILVER;
+    if (steps * 2 <= par * 5) return MEDAL_BRONZE;
+    return MEDAL_EXPLORER;
+}
+
+void showSpeedrunMedal(int steps, int par) {
+    printf("\n===== SPEEDRUN RESULT =====\n");
+    Medal medal = speedrunMedal(steps, par);
+    if (medal == MEDAL_NONE) {
+        printf("Steps: %d, par: unavailable\n", steps);
+        printf("Medal: none – the solver had no par for this run to score against.\n");
+        printf("===========================\n");
+        return;
+    }
+    printf("Steps: %d, par: %d\n", steps, par);
+    if (medal == MEDAL_GOLD) {
+        printf("Medal: GOLD – You found a very efficient path through the maze!\n");
+    } else if (medal == MEDAL_SILVER) {
+        printf("Medal: SILVER – Balanced between exploration and efficiency.\n");
+    } else if (medal == MEDAL_BRONZE) {
+        printf("Medal: BRONZE – You made it, with plenty of detours.\n");
+    } else {
+        printf("Medal: EXPLORER – You took your time and saw a lot of the maze.\n");
+    }
+    printf("===========================\n");
+}
+
+// Player level after a run that earned xp, capped at 50
+int levelAfterRun(int level, int xp) {
+    if (xp >= rules.doubleLevelUpXP) level += 2;
+    else if (xp >= rules.levelUpXP) level += 1;
+    return level > 50 ? 50 : level;
+}
+
+// --- Session ---
+// All the state of one run. The interactive loop and headless replay both feed keys through
+// sessionStep, so a recorded key sequence rebuilds exactly the same run from its seed.
+typedef enum { STEP_INVALID, STEP_DONE, STEP_MOVED, STEP_MET_NPC } StepResult;
+
+typedef struct {
+    Grid grid;
+    CellIndex cells;
+    Reach reach;
+    NPCIndex npcs;
+    Solver solver;
+    RngStreams rng;
+    Player player;
+    uint64_t seed;
+    int level, exitX, exitY;
+    char lastMove;          // direction 'j' jumps in
+    int steps, par;
+    int moodCounts[3];      // SAD, NEUTRAL, HAPPY
+    int trapCount, puzzleCount, bonusCount, philosophyUses;
+    long morphs;            // mood shifts that morphed the maze
+    Arena *arena;           // owns every buffer of a campaign level, NULL = heap
+} Session;
+
+void sessionFree(Session *s) {
+    if (s->arena) return;   // the next level resets the arena over them
+    solverFree(&s->solver);
+    npcIndexFree(&s->npcs);
+    reachFree(&s->reach);
+    cellIndexFree(&s->cells);
+    gridFree(&s->grid);
+}
+
+// Arena bytes a rows x cols level with npcCount NPCs takes: grid, carving stack, cell index,
+// distance field and route, NPCs and the solver's queue
+size_t sessionArenaBytes(int rows, int cols, int npcCount) {
+    size_t total = (size_t)rows * cols;
+    size_t frames = (size_t)((rows + 1) / 2) * ((cols + 1) / 2);
+    size_t buckets = (size_t)((rows >> NPC_BUCKET_SHIFT) + 1) * ((cols >> NPC_BUCKET_SHIFT) + 1);
+    return total + frames * sizeof(CarveFrame) + total * (2 * sizeof(int)) +
+           total * (3 * sizeof(int) + sizeof(long long)) + (npcCount > 0 ? npcCount : 1) * sizeof(NPC) +
+           buckets * sizeof(int) + total * sizeof(int) + 16 * ARENA_ALIGN;
+}
+
+// Seeds the run and carves the maze, false when out of memory. With an arena every buffer of
+// the level comes from it (reset to hold sessionArenaBytes first), and sessionFree leaves them.
+bool sessionGenerateIn(Session *s, Arena *arena, int level, int rows, int cols, const GenConfig *gen,
+                       uint64_t seed, GenStats *stats) {
+    memset(s, 0, sizeof(*s));
+    s->arena = arena;
+    s->seed = seed;
+    s->level = level;
+    s->exitX = rows - 1;
+    s->exitY = cols - 1;
+    s->lastMove = 'd'; // default (right), update each move
+    s->player = (Player){0, 0, NEUTRAL};
+    rngStreamsSeed(&s->rng, seed);
+    // walls, obstacles, visited and preserve flags all live in one byte per cell
+    if (!arena) {
+        if (!gridInit(&s->grid, rows, cols)) return false;
+        generateMaze(&s->grid, s->exitX, s->exitY, gen, &s->rng.gen, stats);
+        return true;
+    }
+    // generateMaze clears the cells, and the DFS gets a stack deep enough for every lattice cell
+    GenConfig carve = gen ? *gen : (GenConfig){GEN_DFS, 1, NULL, 0};
+    carve.stackCap = ((rows + 1) / 2) * ((cols + 1) / 2);
+    carve.stack = (CarveFrame *)arenaAlloc(arena, (size_t)carve.stackCap * sizeof(CarveFrame));
+    s->grid = (Grid){rows, cols, (unsigned char *)arenaAlloc(arena, (size_t)rows * cols), NULL, NULL, 0};
+    if (!carve.stack || !s->grid.cells) return false;
+    generateMaze(&s->grid, s->exitX, s->exitY, &carve, &s->rng.gen, stats);
+    return true;
+}
+
+bool sessionGenerate(Session *s, int level, int rows, int cols, const GenConfig *gen,
+                     uint64_t seed, GenStats *stats) {
+    return sessionGenerateIn(s, NULL, level, rows, cols, gen, seed, stats);
+}
+
+// Obstacles, NPCs, the protected route and par on top of a generated maze
+bool sessionPopulate(Session *s, int npcCount) {
+    Grid *g = &s->grid;
+    Arena *arena = s->arena;
+    if (arena) {
+        // preset buffers: cellIndexBuild keeps them, and no solve reaches more than every cell once
+        int total = g->rows * g->cols;
+        s->cells = (CellIndex){(int *)arenaAlloc(arena, (size_t)total * sizeof(int)),
+                               (int *)arenaAlloc(arena, (size_t)total * sizeof(int)), 0, total, NULL};
+        s->solver.queue = (int *)arenaAlloc(arena, (size_t)total * sizeof(int));
+        s->solver.cap = total;
+        if (!s->cells.cells || !s->cells.pos || !s->solver.queue) return false;
+    }
+    if (!cellIndexBuild(&s->cells, g) || !reachBuild(&s->reach, g, s->exitX, s->exitY, arena) ||
+        !npcIndexInit(&s->npcs, npcCount, g->rows, g->cols, arena)) {
+        return false;
+    }
+    placeObstacles(g, &s->cells, s->exitX, s->exitY, s->level, &s->rng.obstacles);
+    initNPCs(&s->npcs, g, &s->cells, &s->rng.npc);
+    gridSetFlag(g, s->player.x, s->player.y, CELL_VISITED);
+    reachUpdateRoute(&s->reach, g, s->player.x, s->player.y);
+    s->par = solveMaze(&s->solver, g, s->player.x, s->player.y, s->exitX, s->exitY);
+    return true;
+}
+
+bool sessionFinished(const Session *s) {
+    return s->player.x == s->exitX && s->player.y == s->exitY;
+}
+
+// Every successful move rerolls the mood, and a new mood morphs the maze
+void sessionRollMood(Session *s, bool counted) {
+    Mood oldMood = s->player.mood;
+    s->player.mood = generateMood(&s->rng.mood);
+    if (counted) s->moodCounts[s->player.mood]++;
+    if (oldMood != s->player.mood) {
+        say("\nThe maze feels different... mood shift is morphing the labyrinth!\n");
+        s->morphs++;
+        morphMazeWithPar(&s->grid, &s->cells, &s->reach, &s->solver, rules.morphAmount, s->player,
+                         s->exitX, s->exitY, &s->par, &s->rng.morph);
+    }
+}
+
+// Puts the player on (x, y) and counts the step
+void sessionEnter(Session *s, int x, int y) {
+    s->player.x = x;
+    s->player.y = y;
+    gridSetFlag(&s->grid, x, y, CELL_VISITED);
+    reachUpdateRoute(&s->reach, &s->grid, x, y);
+    s->steps++;
+}
+
+// ----- JUMP FEATURE -----
+StepResult sessionJump(Session *s) {
+    Grid *g = &s->grid;
+    int x = s->player.x, y = s->player.y;
+    // two tiles ahead in lastMove direction
+    int jumpX = x, jumpY = y;
+    if (s->lastMove == 'w')      { jumpX -= 2; }
+    else if (s->lastMove == 's') { jumpX += 2; }
+    else if (s->lastMove == 'a') { jumpY -= 2; }
+    else if (s->lastMove == 'd') { jumpY += 2; }
+    int midX = (x + jumpX) / 2;
+    int midY = (y + jumpY) / 2;
+    // will only allow jump over #, not over traps/puzzles/bonus
+    if (gridInBounds(g, jumpX, jumpY) && !gridIsOpen(g, midX, midY) && gridIsOpen(g, jumpX, jumpY) &&
+        gridObstacle(g, midX, midY) == NONE) {
+        sessionEnter(s, jumpX, jumpY);
+        say("You jumped over a wall!\n");
+        // might add a mood boost here, later
+        processObstacle(&s->player, gridObstacle(g, jumpX, jumpY), &s->trapCount, &s->puzzleCount,
+                        &s->bonusCount, g->rows, g->cols);
+        sessionRollMood(s, false);
+        return STEP_MOVED;
+    }
+    // If blocked by letter obstacle, a mini word game would decide; for now the jump is refused
+    if (gridInBounds(g, jumpX, jumpY) && gridObstacle(g, midX, midY) != NONE) {
+        say("Oops! You tried to jump a special tile. Solve this word puzzle to proceed!\n");
+    } else {
+        say("Invalid jump!\n");
+    }
+    return STEP_INVALID;
+}
+
+// Applies one key of the main loop: w/a/s/d move, j jumps, h asks for philosophy support.
+// 'l' (journal) and 'S' (snapshot) only show or save and change nothing here.
+StepResult sessionStep(Session *s, char key) {
+    Grid *g = &s->grid;
+    int newX = s->player.x;
+    int newY = s->player.y;
+
+    if (key == 'w')      { newX--; s->lastMove = 'w'; }
+    else if (key == 's') { newX++; s->lastMove = 's'; }
+    else if (key == 'a') { newY--; s->lastMove = 'a'; }
+    else if (key == 'd') { newY++; s->lastMove = 'd'; }
+    else if (key == 'j') return sessionJump(s);
+    else if (key == 'l' || key == 'S') return STEP_DONE;
+    else if (key == 'h') {
+        // the raw-mode loop and the server show the quote themselves instead of prompting
+        if (!headless && !rawInput && !serving) showRandomPhilosophySupport(&s->rng.ui);
+        s->philosophyUses++;
+        return STEP_DONE;
+    } else {
+        say("Invalid input!\n");
+        return STEP_INVALID;
+    }
+
+    if (!gridInBounds(g, newX, newY) || !gridIsOpen(g, newX, newY)) {
+        say("Invalid move!\n");
+        return STEP_INVALID;
+    }
+    sessionEnter(s, newX, newY);
+    processObstacle(&s->player, gridObstacle(g, newX, newY), &s->trapCount, &s->puzzleCount,
+                    &s->bonusCount, g->rows, g->cols);
+    // a conversation is long enough to scroll the maze off its place on screen
+    bool met = checkNPCEncounter(&s->player, &s->npcs, g, s->steps, s->trapCount, s->puzzleCount,
+                                 s->philosophyUses) > 0;
+    sessionRollMood(s, true);
+    return met ? STEP_MET_NPC : STEP_MOVED;
+}
+
+uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) h = (h ^ bytes[i]) * 0x100000001B3ull;
+    return h;
+}
+
+// FNV-1a over everything a replay has to reproduce: every cell (walls, obstacles, visited,
+// route, NPCs), the NPCs, the player, the counters and the streams that drive later rolls.
+// The ui stream only picks quotes, so it is left out.
+uint64_t sessionHash(const Session *s) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = fnv1a(h, s->grid.cells, (size_t)s->grid.rows * s->grid.cols);
+    for (int i = 0; i < s->npcs.count; i++) {
+        const NPC *npc = &s->npcs.npcs[i];
+        int fields[4] = {npc->x, npc->y, npc->type, npc->active};
+        h = fnv1a(h, fields, sizeof(fields));
+    }
+    int counters[14] = {s->player.x, s->player.y, s->player.mood, s->lastMove, s->steps, s->par,
+                        s->moodCounts[SAD], s->moodCounts[NEUTRAL], s->moodCounts[HAPPY],
+                        s->trapCount, s->puzzleCount, s->bonusCount, s->philosophyUses, s->level};
+    h = fnv1a(h, counters, sizeof(counters));
+    const Rng *streams[5] = {&s->rng.gen, &s->rng.obstacles, &s->rng.mood, &s->rng.npc, &s->rng.morph};
+    for (int i = 0; i < 5; i++) h = fnv1a(h, streams[i], sizeof(Rng));
+    return h;
+}
+
+// --- Key log ---
+// Each session appends one record: "PSYMKEY1" and a KeyLogHeader, then every key the main
+// loop read as one byte, reflection answers as KEYLOG_TEXT, length, bytes, and at the end
+// KEYLOG_END, the step count and the final sessionHash. One file holds any number of runs.
+#define KEYLOG_FILE "session_keys.bin"
+#define KEYLOG_END 0x00
+#define KEYLOG_TEXT 0x01
+
+typedef struct {
+    uint64_t seed;
+    int32_t level, rows, cols, npcs;
+    int32_t genMode, threads;
+    int32_t reserved;
+} KeyLogHeader;
+
+FILE *keyLog = NULL;   // the log the interactive loop is recording into, NULL when not recording
+
+void keyLogOpen(const char *filename, const Session *s, const GenConfig *gen) {
+    keyLog = fopen(filename, "ab");
+    if (!keyLog) {
+        printf("Could not open key log file.\n");
+        return;
+    }
+    KeyLogHeader header = {s->seed, s->level, s->grid.rows, s->grid.cols, s->npcs.count,
+                           gen->mode, gen->threads, 0};
+    fwrite("PSYMKEY1", 1, 8, keyLog);
+    fwrite(&header, sizeof(header), 1, keyLog);
+}
+
+// Control characters never reach sessionStep as anything but invalid input, so they are not kept
+void keyLogKey(char key) {
+    if (keyLog && (unsigned char)key > KEYLOG_TEXT && key != ' ') fputc(key, keyLog);
+}
+
+void keyLogText(const char *text) {
+    if (!keyLog) return;
+    size_t len = strlen(text);
+    if (len > 255) len = 255;
+    fputc(KEYLOG_TEXT, keyLog);
+    fputc((int)len, keyLog);
+    fwrite(text, 1, len, keyLog);
+}
+
+void keyLogClose(const Session *s) {
+    if (!keyLog) return;
+    int32_t steps = s->steps;
+    uint64_t hash = sessionHash(s);
+    fputc(KEYLOG_END, keyLog);
+    fwrite(&steps, sizeof(steps), 1, keyLog);
+    fwrite(&hash, sizeof(hash), 1, keyLog);
+    fclose(keyLog);
+    keyLog = NULL;
+}
+
+// Replays every session in a key log headless and checks each final state against its hash.
+// Returns the number of sessions that did not match or were cut off.
+int replayKeyLog(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        printf("Could not open key log file %s.\n", filename);
+        return 1;
+    }
+    static char buffer[1 << 16];
+    setvbuf(f, buffer, _IOFBF, sizeof(buffer));
+
+    headless = true;
+    journalWrites = false;
+    int sessions = 0, matched = 0, mismatched = 0, incomplete = 0;
+    long keys = 0;
+    double start = nowMillis();
+    char magic[8];
+    while (fread(magic, 1, 8, f) == 8) {
+        KeyLogHeader header;
+        if (memcmp(magic, "PSYMKEY1", 8) != 0 || fread(&header, sizeof(header), 1, f) != 1 ||
+            header.rows < 1 || header.cols < 1) {
+            printf("Key log is corrupt after %d sessions.\n", sessions);
+            incomplete++;
+            break;
+        }
+        sessions++;
+        Session s;
+        GenConfig gen = {(GenMode)header.genMode, header.threads, NULL, 0};
+        if (!sessionGenerate(&s, header.level, header.rows, header.cols, &gen, header.seed, NULL) ||
+            !sessionPopulate(&s, header.npcs)) {
+            printf("Not enough memory to replay a %d x %d session.\n", header.rows, header.cols);
+            sessionFree(&s);
+            incomplete++;
+            break;
+        }
+        bool ended = false;
+        int c;
+        while (!ended && (c = fgetc(f)) != EOF) {
+            if (c == KEYLOG_TEXT) {
+                int len = fgetc(f);
+                if (len == EOF || fseek(f, len, SEEK_CUR) != 0) break;
+            } else if (c == KEYLOG_END) {
+                int32_t steps;
+                uint64_t hash;
+                if (fread(&steps, sizeof(steps), 1, f) != 1 || fread(&hash, sizeof(hash), 1, f) != 1) break;
+                ended = true;
+                if (steps == s.steps && hash == sessionHash(&s)) {
+                    matched++;
+                } else {
+                    mismatched++;
+                    printf("Session %d (seed %llu) does not match: %d steps recorded, %d replayed.\n",
+                           sessions, (unsigned long long)header.seed, steps, s.steps);
+                }
+            } else {
+                sessionStep(&s, (char)c);
+                keys++;
+            }
+        }
+        sessionFree(&s);
+        if (!ended) {
+            printf("Session %d (seed %llu) was cut off before its end record.\n",
+                   sessions, (unsigned long long)header.seed);
+            incomplete++;
+            break;
+        }
+    }
+    headless = false;
+    journalWrites = true;
+    fclose(f);
+
+    double millis = nowMillis() - start;
+    printf("Replayed %d sessions (%ld keys) in %.1f ms, %.0f sessions/s: %d matched, %d mismatched, %d incomplete\n",
+           sessions, keys, millis, millis > 0 ? sessions * 1000.0 / millis : 0.0, matched, mismatched, incomplete);
+    return mismatched + incomplete;
+}
+
+// --- Snapshots ---
+// A run saved with 'S' and picked up again with --resume. The file is a SnapshotHeader and
+// 8-byte aligned sections: open, visited and route bit planes (one bit per cell), the
+// obstacles as nibbles, the open/closed cell order (morphs draw from it, so a resumed run
+// continues exactly like one that never stopped), the distance field (a BFS over a big maze
+// takes seconds, copying it does not), the protected route and the NPCs.
+// Loading maps the file, checks sizes, checksum and every value that indexes something,
+// then unpacks.
+#define SNAPSHOT_FILE "run_snapshot.bin"
+#define SNAPSHOT_MAGIC "PSYMSNP1"
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t checksum;        // snapshotChecksum of everything after the header
+    uint64_t seed;
+    int32_t rows, cols, level, exitX, exitY;
+    int32_t playerX, playerY, mood, lastMove;
+    int32_t steps, par, moodCounts[3];
+    int32_t trapCount, puzzleCount, bonusCount, philosophyUses;
+    int32_t openCount, routeLength, npcCount, reserved;
+    Rng rng[6];               // gen, obstacles, mood, npc, morph, ui
+} SnapshotHeader;
+
+typedef struct {
+    int32_t x, y, type, active;
+} SnapshotNPC;
+
+// Section sizes in bytes, each rounded up to whole words
+typedef struct {
+    size_t plane, obstacles, order, dist, route, npcs, total;
+} SnapshotLayout;
+
+static inline size_t snapshotAlign(size_t bytes) { return (bytes + 7) & ~(size_t)7; }
+
+SnapshotLayout snapshotLayout(size_t cells, size_t routeLength, size_t npcCount) {
+    SnapshotLayout l;
+    l.plane = snapshotAlign((cells + 7) / 8);
+    l.obstacles = snapshotAlign((cells + 1) / 2);
+    l.order = snapshotAlign(cells * sizeof(int32_t));
+    l.dist = l.order;
+    l.route = snapshotAlign(routeLength * sizeof(int32_t));
+    l.npcs = npcCount * sizeof(SnapshotNPC);
+    l.total = sizeof(SnapshotHeader) + 3 * l.plane + l.obstacles + l.order + l.dist + l.route + l.npcs;
+    return l;
+}
+
+// FNV-style hash over whole words in four independent lanes, so it runs at memory speed
+uint64_t snapshotChecksum(const void *data, size_t bytes) {
+    const uint64_t *w = (const uint64_t *)data;
+    size_t words = bytes / 8;
+    uint64_t h[4] = {0xCBF29CE484222325ull, 0x84222325CBF29CE4ull, 0x9CE484222325CBF2ull, 0x2325CBF29CE48422ull};
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        for (int k = 0; k < 4; k++) h[k] = (h[k] ^ w[i + k]) * 0x100000001B3ull;
+    }
+    for (; i < words; i++) h[0] = (h[0] ^ w[i]) * 0x100000001B3ull;
+    return fnv1a(h[0] ^ h[1] * 3 ^ h[2] * 5 ^ h[3] * 7, &bytes, sizeof(bytes));
+}
+
+// Bit k of every cell byte into a plane, 16 cells per movemask with SSE2
+void snapshotPackPlane(const unsigned char *cells, size_t total, int k, unsigned char *plane) {
+    size_t c = 0;
+#ifdef __SSE2__
+    for (; c + 16 <= total; c += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(cells + c));
+        uint16_t bits = (uint16_t)_mm_movemask_epi8(_mm_sll_epi16(v, _mm_cvtsi32_si128(7 - k)));
+        plane[c / 8] = (unsigned char)bits;
+        plane[c / 8 + 1] = (unsigned char)(bits >> 8);
+    }
+#endif
+    for (; c < total; c++) {
+        if ((c & 7) == 0) plane[c / 8] = 0;
+        plane[c / 8] |= (unsigned char)(((cells[c] >> k) & 1) << (c & 7));
+    }
+}
+
+// byteBits[b] has byte i set to 1 when bit i of b is set, 8 cells of a plane at once
+uint64_t byteBits[256];
+
+void snapshotInitTables() {
+    for (int b = 0; b < 256; b++) {
+        uint64_t spread = 0;
+        for (int i = 0; i < 8; i++) spread |= (uint64_t)((b >> i) & 1) << (8 * i);
+        byteBits[b] = spread;
+    }
+}
+
+// Rebuilds every cell byte from the planes, NPC and scratch bits start clear
+void snapshotUnpack(unsigned char *cells, size_t total, const unsigned char *open, const unsigned char *visited,
+                    const unsigned char *route, const unsigned char *obstacles) {
+    if (byteBits[1] == 0) snapshotInitTables();
+    size_t c = 0;
+    for (; c + 8 <= total; c += 8) {
+        size_t b = c / 8;
+        uint64_t obs = 0;
+        for (int i = 0; i < 4; i++) {
+            unsigned char pair = obstacles[c / 2 + i];
+            obs |= (uint64_t)(pair & 0x0F) << (16 * i) | (uint64_t)(pair >> 4) << (16 * i + 8);
+        }
+        uint64_t bytes = byteBits[open[b]] * CELL_OPEN | obs << CELL_OBS_SHIFT |
+                         byteBits[visited[b]] * CELL_VISITED | byteBits[route[b]] * CELL_PRESERVE;
+        memcpy(cells + c, &bytes, 8);
+    }
+    for (; c < total; c++) {
+        int bit = (int)(c & 7);
+        unsigned char obs = (obstacles[c / 2] >> (4 * (c & 1))) & 0x0F;
+        cells[c] = (unsigned char)(((open[c / 8] >> bit) & 1) * CELL_OPEN | obs << CELL_OBS_SHIFT |
+                                   ((visited[c / 8] >> bit) & 1) * CELL_VISITED |
+                                   ((route[c / 8] >> bit) & 1) * CELL_PRESERVE);
+    }
+}
+
+// Writes the snapshot to filename.tmp through a shared mapping and renames it over
+// filename, so a crash mid-save leaves the previous snapshot intact
+bool saveSnapshot(const char *filename, const Session *s) {
+    const Grid *g = &s->grid;
+    size_t total = (size_t)g->rows * g->cols;
+    int routeLength = s->reach.routeEnd - s->reach.routeHead;
+    SnapshotLayout l = snapshotLayout(total, routeLength, s->npcs.count);
+
+    char tmpName[512];
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", filename);
+    int fd = open(tmpName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Could not open snapshot file.\n");
+        return false;
+    }
+    unsigned char *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)l.total) == 0) {
+        map = (unsigned char *)mmap(NULL, l.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        printf("Not enough disk space or memory for the snapshot.\n");
+        close(fd);
+        remove(tmpName);
+        return false;
+    }
+
+    SnapshotHeader *h = (SnapshotHeader *)map;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, SNAPSHOT_MAGIC, 8);
+    h->version = SNAPSHOT_VERSION;
+    h->headerSize = sizeof(SnapshotHeader);
+    h->fileSize = l.total;
+    h->seed = s->seed;
+    h->rows = g->rows;
+    h->cols = g->cols;
+    h->level = s->level;
+    h->exitX = s->exitX;
+    h->exitY = s->exitY;
+    h->playerX = s->player.x;
+    h->playerY = s->player.y;
+    h->mood = s->player.mood;
+    h->lastMove = s->lastMove;
+    h->steps = s->steps;
+    h->par = s->par;
+    for (int m = 0; m < 3; m++) h->moodCounts[m] = s->moodCounts[m];
+    h->trapCount = s->trapCount;
+    h->puzzleCount = s->puzzleCount;
+    h->bonusCount = s->bonusCount;
+    h->philosophyUses = s->philosophyUses;
+    h->openCount = s->cells.openCount;
+    h->routeLength = routeLength;
+    h->npcCount = s->npcs.count;
+    const Rng *streams[6] = {&s->rng.gen, &s->rng.obstacles, &s->rng.mood, &s->rng.npc, &s->rng.morph, &s->rng.ui};
+    for (int k = 0; k < 6; k++) h->rng[k] = *streams[k];
+
+    unsigned char *p = map + sizeof(SnapshotHeader);
+    memset(p, 0, l.total - sizeof(SnapshotHeader));   // padding
+    snapshotPackPlane(g->cells, total, 0, p);                 // CELL_OPEN
+    snapshotPackPlane(g->cells, total, 4, p + l.plane);       // CELL_VISITED
+    snapshotPackPlane(g->cells, total, 5, p + 2 * l.plane);   // CELL_PRESERVE
+    p += 3 * l.plane;
+    for (size_t c = 0; c < total; c++) {
+        p[c / 2] |= (unsigned char)(((g->cells[c] & CELL_OBS_MASK) >> CELL_OBS_SHIFT) << (4 * (c & 1)));
+    }
+    p += l.obstacles;
+    memcpy(p, s->cells.cells, total * sizeof(int32_t));
+    p += l.order;
+    memcpy(p, s->reach.dist, total * sizeof(int32_t));
+    p += l.dist;
+    memcpy(p, s->reach.route + s->reach.routeHead, (size_t)routeLength * sizeof(int32_t));
+    p += l.route;
+    SnapshotNPC *npcs = (SnapshotNPC *)p;
+    for (int i = 0; i < s->npcs.count; i++) {
+        const NPC *npc = &s->npcs.npcs[i];
+        npcs[i] = (SnapshotNPC){npc->x, npc->y, npc->type, npc->active};
+    }
+    h->checksum = snapshotChecksum(map + sizeof(SnapshotHeader), l.total - sizeof(SnapshotHeader));
+
+    bool ok = msync(map, l.total, MS_SYNC) == 0;
+    munmap(map, l.total);
+    close(fd);
+    if (!ok || rename(tmpName, filename) != 0) {
+        printf("Could not write snapshot file.\n");
+        remove(tmpName);
+        return false;
+    }
+    return true;
+}
+
+// Loads a snapshot into a fresh session, false (with the reason printed) if the file is
+// missing, from another version, truncated, corrupt or out of memory
+bool loadSnapshot(const char *filename, Session *s) {
+    memset(s, 0, sizeof(*s));
+    size_t size = 0;
+    const unsigned char *map = (const unsigned char *)mapFile(filename, &size);
+    if (!map) {
+        printf("Could not open snapshot file %s.\n", filename);
+        return false;
+    }
+    const SnapshotHeader *h = (const SnapshotHeader *)map;
+    const char *problem = NULL;
+    SnapshotLayout l = {0};
+    size_t total = 0;
+    if (size < sizeof(SnapshotHeader) || memcmp(h->magic, SNAPSHOT_MAGIC, 8) != 0) {
+        problem = "not a snapshot";
+    } else if (h->version != SNAPSHOT_VERSION || h->headerSize != sizeof(SnapshotHeader)) {
+        problem = "written by a different version";
+    } else if (h->rows < 1 || h->cols < 1 || (long long)h->rows * h->cols > INT32_MAX ||
+               h->routeLength < 0 || h->npcCount < 0 || h->npcCount > 1000000) {
+        problem = "bad dimensions";
+    } else {
+        total = (size_t)h->rows * h->cols;
+        l = snapshotLayout(total, (size_t)h->routeLength, (size_t)h->npcCount);
+        if (h->fileSize != size || l.total != size) problem = "truncated";
+        else if (snapshotChecksum(map + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) != h->checksum)
+            problem = "checksum mismatch";
+    }
+    int rows = 0, cols = 0;
+    if (!problem) {
+        rows = h->rows;
+        cols = h->cols;
+        if (h->playerX < 0 || h->playerX >= rows || h->playerY < 0 || h->playerY >= cols ||
+            h->exitX < 0 || h->exitX >= rows || h->exitY < 0 || h->exitY >= cols ||
+            h->mood < SAD || h->mood > HAPPY || h->lastMove < 0 || h->lastMove > 127 ||
+            !strchr("wasd", h->lastMove) || h->lastMove == 0 ||
+            h->openCount < 0 || (size_t)h->openCount > total || (size_t)h->routeLength > total) {
+            problem = "bad player or counters";
+        }
+    }
+
+    const unsigned char *p = map + sizeof(SnapshotHeader);
+    if (!problem) {
+        if (!gridInit(&s->grid, rows, cols)) {
+            problem = "not enough memory";
+        } else {
+            snapshotUnpack(s->grid.cells, total, p, p + l.plane, p + 2 * l.plane, p + 3 * l.plane);
+        }
+        p += 3 * l.plane + l.obstacles;
+    }
+
+    // the cell order must be a permutation that puts exactly the open cells first
+    if (!problem) {
+        CellIndex *idx = &s->cells;
+        idx->cells = (int *)countedMalloc(total * sizeof(int));
+        idx->pos = (int *)countedMalloc(total * sizeof(int));
+        idx->total = (int)total;
+        idx->openCount = h->openCount;
+        if (!idx->cells || !idx->pos) {
+            problem = "not enough memory";
+        } else {
+            memcpy(idx->cells, p, total * sizeof(int32_t));
+            memset(idx->pos, 0xFF, total * sizeof(int));
+            for (size_t slot = 0; slot < total && !problem; slot++) {
+                int c = idx->cells[slot];
+                if (c < 0 || (size_t)c >= total || idx->pos[c] >= 0 ||
+                    (bool)(s->grid.cells[c] & CELL_OPEN) != (slot < (size_t)h->openCount)) {
+                    problem = "bad cell order";
+                } else {
+                    idx->pos[c] = (int)slot;
+                }
+            }
+        }
+        p += l.order;
+    }
+
+    if (!problem) {
+        s->level = h->level;
+        s->exitX = h->exitX;
+        s->exitY = h->exitY;
+        if (!reachAlloc(&s->reach, &s->grid, s->exitX, s->exitY, NULL)) problem = "not enough memory";
+    }
+    if (!problem) {
+        memcpy(s->reach.dist, p, total * sizeof(int32_t));
+        for (size_t c = 0; c < total && !problem; c++) {
+            int d = s->reach.dist[c];
+            if (d != REACH_INF && (d < 0 || (size_t)d >= total || !(s->grid.cells[c] & CELL_OPEN))) problem = "bad distance field";
+        }
+        p += l.dist;
+    }
+    if (!problem) {
+        const int32_t *route = (const int32_t *)p;
+        for (int k = 0; k < h->routeLength && !problem; k++) {
+            if (route[k] < 0 || (size_t)route[k] >= total) problem = "bad route";
+            else s->reach.route[k] = route[k];
+        }
+        s->reach.routeEnd = h->routeLength;
+        p += l.route;
+    }
+    if (!problem && !npcIndexInit(&s->npcs, h->npcCount, rows, cols, NULL)) problem = "not enough memory";
+    if (!problem) {
+        const SnapshotNPC *npcs = (const SnapshotNPC *)p;
+        for (int i = 0; i < h->npcCount && !problem; i++) {
+            NPC *npc = &s->npcs.npcs[i];
+            if (npcs[i].x < 0 || npcs[i].x >= rows || npcs[i].y < 0 || npcs[i].y >= cols ||
+                npcs[i].type < MENTOR || npcs[i].type > SAGE) {
+                problem = "bad NPC";
+                break;
+            }
+            npc->x = npcs[i].x;
+            npc->y = npcs[i].y;
+            npc->type = (NPCType)npcs[i].type;
+            npc->active = npcs[i].active != 0;
+            npcSetMessages(npc);
+            // same insertion order as initNPCs, so NPCs sharing a tile still speak in order
+            if (npc->active) npcIndexInsert(&s->npcs, &s->grid, i);
+        }
+    }
+    if (!problem) {
+        s->seed = h->seed;
+        s->player = (Player){h->playerX, h->playerY, (Mood)h->mood};
+        s->lastMove = (char)h->lastMove;
+        s->steps = h->steps;
+        s->par = h->par;
+        for (int m = 0; m < 3; m++) s->moodCounts[m] = h->moodCounts[m];
+        s->trapCount = h->trapCount;
+        s->puzzleCount = h->puzzleCount;
+        s->bonusCount = h->bonusCount;
+        s->philosophyUses = h->philosophyUses;
+        Rng *streams[6] = {&s->rng.gen, &s->rng.obstacles, &s->rng.mood, &s->rng.npc, &s->rng.morph, &s->rng.ui};
+        for (int k = 0; k < 6; k++) *streams[k] = h->rng[k];
+    }
+    munmap((void *)map, size);
+    if (problem) {
+        printf("Could not load snapshot %s: %s.\n", filename, problem);
+        sessionFree(s);
+        return false;
+    }
+    return true;
+}
+
+// --- Autosave ---
+// A base snapshot (autosave.bin) plus an append-only log of deltas (autosave.log). The grid
+// and the cell index note every cell and slot they change in a DirtySet, so a delta holds
+// only those, the route if it was re-marked, NPCs that went quiet and the counters and RNG
+// streams: the cost of a save follows the changes, not the maze size. Once the log holds
+// AUTOSAVE_COMPACT_RECORDS deltas or outgrows the base, a fresh base is written and the
+// log starts over. Each delta carries its length and checksum, so after a crash recovery
+// applies deltas until the first torn one and has the last state that was fully written.
+#define AUTOSAVE_BASE "autosave.bin"
+#define AUTOSAVE_LOG "autosave.log"
+#define AUTOSAVE_LOG_MAGIC "PSYMCKL1"
+#define AUTOSAVE_RECORD_MAGIC 0x544C4544u   // "DELT"
+#define AUTOSAVE_COMPACT_RECORDS 1000
+#define AUTOSAVE_CELL_BITS (CELL_OPEN | CELL_OBS_MASK | CELL_VISITED | CELL_PRESERVE)
+
+const char *autosaveBase = AUTOSAVE_BASE;
+const char *autosaveLog = AUTOSAVE_LOG;
+
+typedef struct {
+    char magic[8];
+    uint64_t baseChecksum;    // the log only applies on top of the base with this checksum
+} AutosaveLogHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t bytes;           // whole record, header included, a multiple of 8
+    uint64_t checksum;        // snapshotChecksum of the record with this field zeroed
+    uint32_t sequence;
+    int32_t cellCount, slotCount, npcCount;
+    int32_t routeRebuilt;     // 1: routeCount cells follow, 0: the head moved routeCount cells on
+    int32_t routeCount;
+    int32_t playerX, playerY, mood, lastMove;
+    int32_t steps, par, moodCounts[3];
+    int32_t trapCount, puzzleCount, bonusCount, philosophyUses;
+    int32_t openCount, reserved;
+    Rng rng[6];
+} AutosaveRecord;
+
+typedef struct {
+    int steps;                // write a delta every this many moves, 0 = only on morphs
+    bool onMorph;             // and after every morph
+} AutosaveConfig;
+
+typedef struct {
+    FILE *log;
+    AutosaveConfig cfg;
+    DirtySet cellChanges, slotChanges;
+    unsigned char *npcActive;     // NPC activity as of the last delta
+    int routeHead;                // route head as of the last delta
+    long routeRebuilds;
+    long morphs;
+    int movesSinceSave;
+    uint32_t sequence;
+    long records;                 // deltas since the base
+    long logBytes, baseBytes;
+    unsigned char *buffer;
+    size_t bufferCap;
+    double lastMicros;            // time of the last save
+    bool running;
+} Autosave;
+
+// Reads the checksum a snapshot file was written with, 0 if it is not a snapshot
+uint64_t snapshotFileChecksum(const char *filename, long *size) {
+    FILE *f = fopen(filename, "rb");
+    SnapshotHeader h;
+    uint64_t checksum = 0;
+    if (f && fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, SNAPSHOT_MAGIC, 8) == 0) {
+        checksum = h.checksum;
+        if (size) *size = (long)h.fileSize;
+    }
+    if (f) fclose(f);
+    return checksum;
+}
+
+// Writes a new base and starts an empty log on top of it
+bool autosaveCompact(Autosave *a, const Session *s) {
+    if (a->log) fclose(a->log);
+    a->log = NULL;
+    if (!saveSnapshot(autosaveBase, s)) return false;
+    AutosaveLogHeader header;
+    memcpy(header.magic, AUTOSAVE_LOG_MAGIC, 8);
+    header.baseChecksum = snapshotFileChecksum(autosaveBase, &a->baseBytes);
+    // the new log replaces the old one in a single rename, either goes with the right base
+    char tmpName[512];
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", autosaveLog);
+    FILE *f = fopen(tmpName, "wb");
+    if (!f || fwrite(&header, sizeof(header), 1, f) != 1 || fclose(f) != 0 ||
+        rename(tmpName, autosaveLog) != 0) {
+        printf("Could not write autosave log.\n");
+        return false;
+    }
+    a->log = fopen(autosaveLog, "ab");
+    if (!a->log) return false;
+    dirtySetClear(&a->cellChanges);
+    dirtySetClear(&a->slotChanges);
+    for (int i = 0; i < s->npcs.count; i++) a->npcActive[i] = s->npcs.npcs[i].active;
+    a->routeHead = s->reach.routeHead;
+    a->routeRebuilds = s->reach.rebuilds;
+    a->records = 0;
+    a->logBytes = sizeof(header);
+    return true;
+}
+
+// Makes room for one more record of bytes in the assembly buffer
+static bool autosaveReserve(Autosave *a, size_t bytes) {
+    if (bytes <= a->bufferCap) return true;
+    size_t cap = a->bufferCap ? a->bufferCap : 4096;
+    while (cap < bytes) cap *= 2;
+    unsigned char *buffer = (unsigned char *)countedRealloc(a->buffer, cap);
+    if (!buffer) return false;
+    a->buffer = buffer;
+    a->bufferCap = cap;
+    return true;
+}
+
+// Appends one delta, or compacts when the log is due for it
+bool autosaveSave(Autosave *a, const Session *s) {
+    double start = nowMillis();
+    a->movesSinceSave = 0;
+    a->morphs = s->morphs;
+    if (a->cellChanges.overflow || a->slotChanges.overflow || a->records >= AUTOSAVE_COMPACT_RECORDS ||
+        a->logBytes > a->baseBytes) {
+        bool ok = autosaveCompact(a, s);
+        a->lastMicros = (nowMillis() - start) * 1000.0;
+        return ok;
+    }
+    const Reach *reach = &s->reach;
+    bool rebuilt = reach->rebuilds != a->routeRebuilds;
+    int routeCount = rebuilt ? reach->routeEnd - reach->routeHead : reach->routeHead - a->routeHead;
+    int npcChanged = 0;
+    for (int i = 0; i < s->npcs.count; i++) npcChanged += s->npcs.npcs[i].active != a->npcActive[i];
+    int cellCount = a->cellChanges.count, slotCount = a->slotChanges.count;
+    size_t bytes = sizeof(AutosaveRecord) + (size_t)cellCount * 5 + (size_t)slotCount * 8 +
+                   (rebuilt ? (size_t)routeCount * 4 : 0) + (size_t)npcChanged * 8;
+    bytes = snapshotAlign(bytes);
+    if (!autosaveReserve(a, bytes)) return false;
+
+    memset(a->buffer, 0, bytes);
+    AutosaveRecord *rec = (AutosaveRecord *)a->buffer;
+    rec->magic = AUTOSAVE_RECORD_MAGIC;
+    rec->bytes = (uint32_t)bytes;
+    rec->sequence = ++a->sequence;
+    rec->cellCount = cellCount;
+    rec->slotCount = slotCount;
+    rec->npcCount = npcChanged;
+    rec->routeRebuilt = rebuilt;
+    rec->routeCount = routeCount;
+    rec->playerX = s->player.x;
+    rec->playerY = s->player.y;
+    rec->mood = s->player.mood;
+    rec->lastMove = s->lastMove;
+    rec->steps = s->steps;
+    rec->par = s->par;
+    for (int m = 0; m < 3; m++) rec->moodCounts[m] = s->moodCounts[m];
+    rec->trapCount = s->trapCount;
+    rec->puzzleCount = s->puzzleCount;
+    rec->bonusCount = s->bonusCount;
+    rec->philosophyUses = s->philosophyUses;
+    rec->openCount = s->cells.openCount;
+    const Rng *streams[6] = {&s->rng.gen, &s->rng.obstacles, &s->rng.mood, &s->rng.npc, &s->rng.morph, &s->rng.ui};
+    for (int k = 0; k < 6; k++) rec->rng[k] = *streams[k];
+
+    // cell ids, then their saved bits, then slot/cell pairs, the route and index/active pairs
+    int32_t *ids = (int32_t *)(rec + 1);
+    unsigned char *values = (unsigned char *)(ids + cellCount);
+    for (int k = 0; k < cellCount; k++) {
+        int c = a->cellChanges.items[k];
+        ids[k] = c;
+        values[k] = s->grid.cells[c] & AUTOSAVE_CELL_BITS;
+    }
+    int32_t *words = (int32_t *)(values + ((cellCount + 3) & ~3));
+    for (int k = 0; k < slotCount; k++) {
+        int slot = a->slotChanges.items[k];
+        *words++ = slot;
+        *words++ = s->cells.cells[slot];
+    }
+    if (rebuilt) {
+        memcpy(words, reach->route + reach->routeHead, (size_t)routeCount * sizeof(int32_t));
+        words += routeCount;
+    }
+    for (int i = 0; i < s->npcs.count; i++) {
+        if (s->npcs.npcs[i].active == a->npcActive[i]) continue;
+        *words++ = i;
+        *words++ = s->npcs.npcs[i].active;
+        a->npcActive[i] = s->npcs.npcs[i].active;
+    }
+    rec->checksum = snapshotChecksum(a->buffer, bytes);
+
+    if (fwrite(a->buffer, 1, bytes, a->log) != bytes || fflush(a->log) != 0) {
+        printf("Could not write autosave log.\n");
+        return false;
+    }
+    dirtySetClear(&a->cellChanges);
+    dirtySetClear(&a->slotChanges);
+    a->routeHead = reach->routeHead;
+    a->routeRebuilds = reach->rebuilds;
+    a->records++;
+    a->logBytes += (long)bytes;
+    a->lastMicros = (nowMillis() - start) * 1000.0;
+    return true;
+}
+
+// Starts tracking changes on s and writes its base, false if that fails
+bool autosaveStart(Autosave *a, Session *s, AutosaveConfig cfg) {
+    memset(a, 0, sizeof(*a));
+    a->cfg = cfg;
+    size_t total = (size_t)s->grid.rows * s->grid.cols;
+    a->npcActive = (unsigned char *)countedCalloc(s->npcs.count > 0 ? s->npcs.count : 1, 1);
+    if (!a->npcActive || !dirtySetInit(&a->cellChanges, total) || !dirtySetInit(&a->slotChanges, total)) {
+        printf("Not enough memory for autosave.\n");
+        return false;
+    }
+    s->grid.changes = &a->cellChanges;
+    s->cells.changes = &a->slotChanges;
+    a->morphs = s->morphs;
+    a->running = autosaveCompact(a, s);
+    return a->running;
+}
+
+// Called after every move, saves when the config says it is time
+void autosaveAfterMove(Autosave *a, const Session *s) {
+    if (!a->running) return;
+    a->movesSinceSave++;
+    if ((a->cfg.steps > 0 && a->movesSinceSave >= a->cfg.steps) || (a->cfg.onMorph && s->morphs != a->morphs)) {
+        if (!autosaveSave(a, s)) a->running = false;
+    }
+}
+
+// A finished run needs no autosave; an abandoned one saves what is left and keeps it
+void autosaveStop(Autosave *a, Session *s, bool finished) {
+    if (a->running && !finished && a->movesSinceSave > 0) autosaveSave(a, s);
+    if (a->log) fclose(a->log);
+    if (a->running && finished) {
+        remove(autosaveLog);
+        remove(autosaveBase);
+    }
+    s->grid.changes = NULL;
+    s->cells.changes = NULL;
+    dirtySetFree(&a->cellChanges);
+    dirtySetFree(&a->slotChanges);
+    free(a->npcActive);
+    free(a->buffer);
+    memset(a, 0, sizeof(*a));
+}
+
+bool autosaveExists() {
+    struct stat st;
+    return stat(autosaveBase, &st) == 0;
+}
+
+// Applies one checked record to s, false if it points outside the session
+static bool autosaveApply(Session *s, const AutosaveRecord *rec) {
+    size_t total = (size_t)s->grid.rows * s->grid.cols;
+    size_t need = sizeof(*rec) + (size_t)rec->cellCount * 5 + (size_t)rec->slotCount * 8 +
+                  (rec->routeRebuilt ? (size_t)rec->routeCount * 4 : 0) + (size_t)rec->npcCount * 8;
+    if (rec->cellCount < 0 || rec->slotCount < 0 || rec->npcCount < 0 || rec->routeCount < 0 ||
+        need > rec->bytes || rec->npcCount > s->npcs.count || rec->openCount < 0 || (size_t)rec->openCount > total ||
+        rec->playerX < 0 || rec->playerX >= s->grid.rows || rec->playerY < 0 || rec->playerY >= s->grid.cols ||
+        rec->mood < SAD || rec->mood > HAPPY) {
+        return false;
+    }
+    const int32_t *ids = (const int32_t *)(rec + 1);
+    const unsigned char *values = (const unsigned char *)(ids + rec->cellCount);
+    for (int k = 0; k < rec->cellCount; k++) {
+        if (ids[k] < 0 || (size_t)ids[k] >= total) return false;
+        unsigned char *c = &s->grid.cells[ids[k]];
+        *c = (unsigned char)((*c & ~AUTOSAVE_CELL_BITS) | (values[k] & AUTOSAVE_CELL_BITS));
+    }
+    const int32_t *words = (const int32_t *)(values + ((rec->cellCount + 3) & ~3));
+    for (int k = 0; k < rec->slotCount; k++, words += 2) {
+        if (words[0] < 0 || (size_t)words[0] >= total || words[1] < 0 || (size_t)words[1] >= total) return false;
+        s->cells.cells[words[0]] = words[1];
+        s->cells.pos[words[1]] = words[0];
+    }
+    s->cells.openCount = rec->openCount;
+    Reach *reach = &s->reach;
+    if (rec->routeRebuilt) {
+        if ((size_t)rec->routeCount > total) return false;
+        for (int k = 0; k < rec->routeCount; k++) {
+            if (words[k] < 0 || (size_t)words[k] >= total) return false;
+            reach->route[k] = words[k];
+        }
+        words += rec->routeCount;
+        reach->routeHead = 0;
+        reach->routeEnd = rec->routeCount;
+    } else {
+        if (rec->routeCount > reach->routeEnd - reach->routeHead) return false;
+        reach->routeHead += rec->routeCount;
+    }
+    for (int k = 0; k < rec->npcCount; k++, words += 2) {
+        if (words[0] < 0 || words[0] >= s->npcs.count) return false;
+        NPC *npc = &s->npcs.npcs[words[0]];
+        bool active = words[1] != 0;
+        if (npc->active && !active) npcIndexRemove(&s->npcs, &s->grid, words[0]);
+        else if (!npc->active && active) npcIndexInsert(&s->npcs, &s->grid, words[0]);
+        npc->active = active;
+    }
+    s->player = (Player){rec->playerX, rec->playerY, (Mood)rec->mood};
+    s->lastMove = (char)rec->lastMove;
+    s->steps = rec->steps;
+    s->par = rec->par;
+    for (int m = 0; m < 3; m++) s->moodCounts[m] = rec->moodCounts[m];
+    s->trapCount = rec->trapCount;
+    s->puzzleCount = rec->puzzleCount;
+    s->bonusCount = rec->bonusCount;
+    s->philosophyUses = rec->philosophyUses;
+    Rng *streams[6] = {&s->rng.gen, &s->rng.obstacles, &s->rng.mood, &s->rng.npc, &s->rng.morph, &s->rng.ui};
+    for (int k = 0; k < 6; k++) *streams[k] = rec->rng[k];
+    return true;
+}
+
+// Rebuilds the last fully written state: the base, then every intact delta on top of it.
+// Returns the number of deltas applied, -1 if there is no usable base.
+long autosaveRecover(Session *s) {
+    if (!loadSnapshot(autosaveBase, s)) return -1;
+    long applied = 0;
+    FILE *f = fopen(autosaveLog, "rb");
+    AutosaveLogHeader header;
+    if (!f || fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, AUTOSAVE_LOG_MAGIC, 8) != 0 ||
+        header.baseChecksum != snapshotFileChecksum(autosaveBase, NULL)) {
+        // no log, or one left over from before the last compaction: the base is the latest state
+        if (f) fclose(f);
+        return 0;
+    }
+    size_t cap = 0;
+    unsigned char *buffer = NULL;
+    AutosaveRecord rec;
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        if (rec.magic != AUTOSAVE_RECORD_MAGIC || rec.bytes < sizeof(rec) || rec.bytes % 8 != 0) break;
+        if (rec.bytes > cap) {
+            unsigned char *grown = (unsigned char *)countedRealloc(buffer, rec.bytes);
+            if (!grown) break;
+            buffer = grown;
+            cap = rec.bytes;
+        }
+        memcpy(buffer, &rec, sizeof(rec));
+        if (fread(buffer + sizeof(rec), 1, rec.bytes - sizeof(rec), f) != rec.bytes - sizeof(rec)) break;
+        uint64_t checksum = rec.checksum;
+        ((AutosaveRecord *)buffer)->checksum = 0;
+        if (snapshotChecksum(buffer, rec.bytes) != checksum) break;   // torn write, stop here
+        if (!autosaveApply(s, (const AutosaveRecord *)buffer)) {
+            printf("Autosave delta %u does not fit the saved maze, stopping before it.\n", rec.sequence);
+            break;
+        }
+        applied++;
+    }
+    free(buffer);
+    fclose(f);
+    // distances follow from the grid; the route was restored as saved
+    if (applied > 0) reachFill(&s->reach, &s->grid);
+    return applied;
+}
+
+// --- Work-stealing pool ---
+// Tasks are numbers [0, count). Each worker starts with an even slice and takes tasks from
+// its bottom; once its slice is empty it steals the top half of the fullest other slice.
+// Every slice has its own lock, held only to take or split, so workers rarely wait.
+typedef struct {
+    pthread_mutex_t lock;
+    long next, end;
+} PoolRange;
+
+typedef void (*PoolTaskFn)(void *ctx, int worker, long task);
+
+typedef struct {
+    PoolRange *ranges;
+    int workers;
+    PoolTaskFn run;
+    void *ctx;
+    atomic_long steals;
+} TaskPool;
+
+typedef struct {
+    TaskPool *pool;
+    int worker;
+    pthread_t thread;
+    bool spawned;
+} PoolWorker;
+
+static long poolTake(PoolRange *range) {
+    pthread_mutex_lock(&range->lock);
+    long task = range->next < range->end ? range->next++ : -1;
+    pthread_mutex_unlock(&range->lock);
+    return task;
+}
+
+// Moves the top half of the fullest other slice to worker w, false when every slice is empty
+static bool poolSteal(TaskPool *pool, int w) {
+    for (;;) {
+        int victim = -1;
+        long most = 0;
+        for (int v = 0; v < pool->workers; v++) {
+            if (v == w) continue;
+            PoolRange *range = &pool->ranges[v];
+            pthread_mutex_lock(&range->lock);
+            long left = range->end - range->next;
+            pthread_mutex_unlock(&range->lock);
+            if (left > most) {
+                most = left;
+                victim = v;
+            }
+        }
+        if (victim < 0) return false;
+        PoolRange *from = &pool->ranges[victim];
+        pthread_mutex_lock(&from->lock);
+        long left = from->end - from->next;
+        long take = left - left / 2;
+        from->end -= take;
+        long stolen = from->end;
+        pthread_mutex_unlock(&from->lock);
+        if (take <= 0) continue;   // its owner got there first, look again
+        PoolRange *own = &pool->ranges[w];
+        pthread_mutex_lock(&own->lock);
+        own->next = stolen;
+        own->end = stolen + take;
+        pthread_mutex_unlock(&own->lock);
+        pool->steals++;
+        return true;
+    }
+}
+
+static void *poolWorker(void *arg) {
+    PoolWorker *pw = (PoolWorker *)arg;
+    TaskPool *pool = pw->pool;
+    for (;;) {
+        long task = poolTake(&pool->ranges[pw->worker]);
+        if (task >= 0) pool->run(pool->ctx, pw->worker, task);
+        else if (!poolSteal(pool, pw->worker)) break;
+    }
+    return NULL;
+}
+
+// Runs run(ctx, worker, task) for every task on workers threads, worker 0 on this one.
+// Returns the number of steals, -1 if the pool could not be set up.
+long poolRun(int workers, long count, PoolTaskFn run, void *ctx) {
+    TaskPool pool = {NULL, workers, run, ctx, 0};
+    pool.ranges = (PoolRange *)countedCalloc(workers, sizeof(PoolRange));
+    PoolWorker *threads = (PoolWorker *)countedCalloc(workers, sizeof(PoolWorker));
+    if (!pool.ranges || !threads) {
+        free(pool.ranges);
+        free(threads);
+        return -1;
+    }
+    for (int w = 0; w < workers; w++) {
+        pthread_mutex_init(&pool.ranges[w].lock, NULL);
+        pool.ranges[w].next = count * w / workers;
+        pool.ranges[w].end = count * (w + 1) / workers;
+        threads[w] = (PoolWorker){&pool, w, 0, false};
+    }
+    // a worker that cannot start leaves its slice to be stolen
+    for (int w = 1; w < workers; w++) {
+        threads[w].spawned = pthread_create(&threads[w].thread, NULL, poolWorker, &threads[w]) == 0;
+    }
+    poolWorker(&threads[0]);
+    for (int w = 1; w < workers; w++) {
+        if (threads[w].spawned) pthread_join(threads[w].thread, NULL);
+    }
+    for (int w = 0; w < workers; w++) pthread_mutex_destroy(&pool.ranges[w].lock);
+    long steals = pool.steals;
+    free(pool.ranges);
+    free(threads);
+    return steals;
+}
+
+// --- Difficulty simulator ---
+// --simulate RUNS plays RUNS sessions per level and bot without a screen. Bots only choose
+// keys; sessionStep applies them, so obstacles, moods, morphs, NPCs, par, XP and medals all
+// follow the real rules (including any --rules overrides). Run n of the simulation seeds
+// its maze and its bot from n, so the totals do not depend on which worker played it.
+typedef enum { BOT_RANDOM, BOT_WALL, BOT_OPTIMAL, BOT_COUNT } BotKind;
+const char *botNames[BOT_COUNT] = {"random", "wall", "optimal"};
+
+// Clockwise from up, so turning right is the next index
+static const char botKeys[4] = {'w', 'd', 's', 'a'};
+static const int botDx[4] = {-1, 0, 1, 0}, botDy[4] = {0, 1, 0, -1};
+
+typedef struct {
+    int heading;     // wall follower: index into botKeys
+    Rng rng;
+    int *dist;       // optimal player: moves to the exit, jumps included
+    int *queue;
+    long morphs;     // dist is from before this many morphs
+} Bot;
+
+// Can the player go from (x, y) one step or one jump in direction d, and to which cell
+static int botMove(const Grid *g, int x, int y, int d, bool jump) {
+    int nx = x + botDx[d], ny = y + botDy[d];
+    if (!gridInBounds(g, nx, ny)) return -1;
+    if (!jump) return gridIsOpen(g, nx, ny) ? nx * g->cols + ny : -1;
+    int jx = nx + botDx[d], jy = ny + botDy[d];
+    if (!gridInBounds(g, jx, jy) || gridIsOpen(g, nx, ny) || gridObstacle(g, nx, ny) != NONE) return -1;
+    return gridIsOpen(g, jx, jy) ? jx * g->cols + jy : -1;
+}
+
+// BFS from the exit over steps and jumps; both are their own reverse, so this is the
+// fewest moves from every open cell. Redone only after a morph changed the maze.
+static void botDistances(Bot *b, const Session *s) {
+    const Grid *g = &s->grid;
+    int total = g->rows * g->cols, head = 0, tail = 0;
+    for (int c = 0; c < total; c++) b->dist[c] = REACH_INF;
+    b->dist[s->exitX * g->cols + s->exitY] = 0;
+    b->queue[tail++] = s->exitX * g->cols + s->exitY;
+    while (head < tail) {
+        int u = b->queue[head++];
+        for (int m = 0; m < 8; m++) {
+            int v = botMove(g, u / g->cols, u % g->cols, m & 3, m >= 4);
+            if (v >= 0 && b->dist[v] == REACH_INF) {
+                b->dist[v] = b->dist[u] + 1;
+                b->queue[tail++] = v;
+            }
+        }
+    }
+    b->morphs = s->morphs;
+}
+
+// Picks the next key of a bot. The random walker mashes keys, the wall follower keeps its
+// right hand on the wall, and the optimal player takes a step or jump that brings it
+// closest to the exit (facing the wall first before a jump, which costs no step).
+char botKey(BotKind kind, Bot *b, const Session *s) {
+    const Grid *g = &s->grid;
+    int x = s->player.x, y = s->player.y;
+    if (kind == BOT_RANDOM) return "wasdwasdwj"[rngBelow(&b->rng, 10)];
+    if (kind == BOT_WALL) {
+        static const int turns[4] = {1, 0, 3, 2};   // right, ahead, left, back
+        for (int t = 0; t < 4; t++) {
+            int d = (b->heading + turns[t]) & 3;
+            if (gridInBounds(g, x + botDx[d], y + botDy[d]) && gridIsOpen(g, x + botDx[d], y + botDy[d])) {
+                b->heading = d;
+                return botKeys[d];
+            }
+        }
+        return botKeys[b->heading];
+    }
+    if (b->morphs != s->morphs) botDistances(b, s);
+    int best = b->dist[x * g->cols + y], bestMove = -1;
+    for (int m = 0; m < 8; m++) {     // steps first, so a jump has to be strictly better
+        int v = botMove(g, x, y, m & 3, m >= 4);
+        if (v >= 0 && b->dist[v] < best) {
+            best = b->dist[v];
+            bestMove = m;
+        }
+    }
+    int bestDir = bestMove & 3;
+    bool jump = bestMove >= 4;
+    if (bestMove < 0) return "wasd"[rngBelow(&b->rng, 4)];   // nothing closer, should not happen
+    if (jump && s->lastMove == botKeys[bestDir]) return 'j';
+    return botKeys[bestDir];    // a step, or a bump into the wall to face the jump
+}
+
+typedef struct {
+    long runs, gaveUp, unwinnable;   // gave up: out of keys; unwinnable: no path at the start
+    long long traps, moods[3], xp;   // finished runs only, like everything below
+    int maxTraps;
+    long medals[4];
+    long levelUps[3];                // runs worth 0, 1 and 2 player levels
+} SimCell;
+
+typedef struct {
+    StatsSummary won[BOT_COUNT];     // steps and XP of finished runs by level
+    SimCell cells[BOT_COUNT][STATS_LEVELS + 1];
+} SimTally;
+
+typedef struct {
+    int firstLevel, lastLevel;
+    BotKind bots[BOT_COUNT];
+    int botCount;
+    long runs;                       // per level and bot
+    uint64_t seed;
+    int npcs;
+    int keyBudget;                   // keys per cell of the maze before a bot gives up
+    SimTally *tallies;               // one per worker
+} SimConfig;
+
+static void simRun(void *ctx, int worker, long task) {
+    SimConfig *cfg = (SimConfig *)ctx;
+    long rest = task / cfg->runs;
+    BotKind kind = cfg->bots[rest % cfg->botCount];
+    int level = cfg->firstLevel + (int)(rest / cfg->botCount);
+    SimTally *tally = &cfg->tallies[worker];
+    SimCell *cell = &tally->cells[kind][level];
+
+    Session s;
+    GenConfig gen = {GEN_DFS, 1, NULL, 0};
+    int size = levelToSize(level);
+    uint64_t seed = cfg->seed + (uint64_t)task * 0x9E3779B97F4A7C15ull;
+    cell->runs++;
+    if (!sessionGenerate(&s, level, size, size, &gen, seed, NULL) || !sessionPopulate(&s, cfg->npcs)) {
+        sessionFree(&s);
+        cell->gaveUp++;
+        return;
+    }
+    if (s.reach.dist[s.player.x * size + s.player.y] == REACH_INF) {
+        cell->unwinnable++;
+        sessionFree(&s);
+        return;
+    }
+    Bot bot = {1, {0}, NULL, NULL, -1};
+    rngSeed(&bot.rng, seed, 7);
+    if (kind == BOT_OPTIMAL) {
+        bot.dist = (int *)countedMalloc((size_t)size * size * sizeof(int));
+        bot.queue = (int *)countedMalloc((size_t)size * size * sizeof(int));
+    }
+    long keys = (long)cfg->keyBudget * size * size;
+    if (kind != BOT_OPTIMAL || (bot.dist && bot.queue)) {
+        while (!sessionFinished(&s) && keys-- > 0) sessionStep(&s, botKey(kind, &bot, &s));
+    }
+    free(bot.dist);
+    free(bot.queue);
+    if (!sessionFinished(&s)) {
+        cell->gaveUp++;
+        sessionFree(&s);
+        return;
+    }
+    int xp = showAchievementsAndComputeXP(s.steps, s.par, s.moodCounts, s.trapCount, s.puzzleCount,
+                                          s.bonusCount, s.philosophyUses);
+    StatsRecord record = {seed, 0, level, 0, s.steps, s.par, xp, {0}, s.trapCount, 0, 0, 0};
+    statsCount(&tally->won[kind], &record, 1);
+    cell->traps += s.trapCount;
+    cell->xp += xp;
+    if (s.trapCount > cell->maxTraps) cell->maxTraps = s.trapCount;
+    for (int m = 0; m < 3; m++) cell->moods[m] += s.moodCounts[m];
+    Medal medal = speedrunMedal(s.steps, s.par);
+    if (medal != MEDAL_NONE) cell->medals[medal]++;
+    cell->levelUps[levelAfterRun(0, xp)]++;
+    sessionFree(&s);
+}
+
+// Parses --bots random,wall,optimal
+bool parseBots(const char *list, SimConfig *cfg) {
+    cfg->botCount = 0;
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    for (char *name = strtok(buffer, ","); name; name = strtok(NULL, ",")) {
+        int k = 0;
+        while (k < BOT_COUNT && strcmp(name, botNames[k]) != 0) k++;
+        if (k == BOT_COUNT || cfg->botCount == BOT_COUNT) {
+            printf("Unknown bot: %s (use random, wall or optimal)\n", name);
+            return false;
+        }
+        cfg->bots[cfg->botCount++] = (BotKind)k;
+    }
+    return cfg->botCount > 0;
+}
+
+// Parses --rules name=value,... into rules
+bool parseRules(const char *list) {
+    struct { const char *name; int *value; } knobs[] = {
+        {"baseDiv", &rules.baseDiv}, {"minTrapDiv", &rules.minTrapDiv}, {"levelsPerDiv", &rules.levelsPerDiv},
+        {"powerupCells", &rules.powerupCells}, {"morph", &rules.morphAmount},
+        {"levelUpXP", &rules.levelUpXP}, {"doubleLevelUpXP", &rules.doubleLevelUpXP},
+    };
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    for (char *item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        char *eq = strchr(item, '=');
+        size_t k = 0;
+        if (eq) *eq = '\0';
+        while (k < sizeof(knobs) / sizeof(knobs[0]) && strcmp(item, knobs[k].name) != 0) k++;
+        if (!eq || k == sizeof(knobs) / sizeof(knobs[0]) || atoi(eq + 1) < 1) {
+            printf("Bad rule: %s (use baseDiv, minTrapDiv, levelsPerDiv, powerupCells, morph,"
+                   " levelUpXP or doubleLevelUpXP = a positive number)\n", item);
+            return false;
+        }
+        *knobs[k].value = atoi(eq + 1);
+    }
+    return true;
+}
+
+// Plays every run of cfg on threads workers and prints the distributions per level and bot
+bool simulate(SimConfig *cfg, int threads) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    long tasks = (long)(cfg->lastLevel - cfg->firstLevel + 1) * cfg->botCount * cfg->runs;
+    if (tasks < threads) threads = tasks > 0 ? (int)tasks : 1;
+    cfg->tallies = (SimTally *)countedCalloc(threads, sizeof(SimTally));
+    int ready = 0;
+    while (cfg->tallies && ready < threads * BOT_COUNT &&
+           statsSummaryInit(&cfg->tallies[ready / BOT_COUNT].won[ready % BOT_COUNT])) {
+        ready++;
+    }
+    bool headlessBefore = headless, journalBefore = journalWrites;
+    headless = true;
+    journalWrites = false;
+    double start = nowMillis();
+    long steals = ready == threads * BOT_COUNT ? poolRun(threads, tasks, simRun, cfg) : -1;
+    double seconds = (nowMillis() - start) / 1000.0;
+    headless = headlessBefore;
+    journalWrites = journalBefore;
+
+    // fold every worker into the first
+    SimTally *total = cfg->tallies;
+    bool ok = steals >= 0;
+    for (int w = 1; ok && w < threads; w++) {
+        for (int k = 0; k < BOT_COUNT; k++) {
+            ok &= statsMerge(&total->won[k], &cfg->tallies[w].won[k]);
+            for (int l = 0; l <= STATS_LEVELS; l++) {
+                SimCell *a = &total->cells[k][l];
+                const SimCell *b = &cfg->tallies[w].cells[k][l];
+                a->runs += b->runs;
+                a->gaveUp += b->gaveUp;
+                a->unwinnable += b->unwinnable;
+                a->traps += b->traps;
+                a->xp += b->xp;
+                if (b->maxTraps > a->maxTraps) a->maxTraps = b->maxTraps;
+                for (int m = 0; m < 3; m++) a->moods[m] += b->moods[m];
+                for (int m = 0; m < 4; m++) a->medals[m] += b->medals[m];
+                for (int m = 0; m < 3; m++) a->levelUps[m] += b->levelUps[m];
+            }
+        }
+    }
+    if (!ok) {
+        printf("Not enough memory for the simulation.\n");
+    } else {
+        printf("===== SIMULATION: %ld runs on %d threads in %.2f s (%.0f runs/s, %ld steals) =====\n",
+               tasks, threads, seconds, tasks / (seconds > 0 ? seconds : 1e-9), steals);
+        printf("Rules: baseDiv=%d minTrapDiv=%d levelsPerDiv=%d powerupCells=%d morph=%d levelUpXP=%d doubleLevelUpXP=%d\n",
+               rules.baseDiv, rules.minTrapDiv, rules.levelsPerDiv, rules.powerupCells, rules.morphAmount,
+               rules.levelUpXP, rules.doubleLevelUpXP);
+        printf("Finished runs only from Steps on; level-ups in %% of them, medals in %% of those with a par.\n");
+        printf("Level Bot      Won%%  GaveUp%% NoPath%%  Steps    p50    p99  Traps  max  Sad  Neu  Hap"
+               "    XP  Gold Silv Brnz Expl   +1   +2\n");
+        for (int l = cfg->firstLevel; l <= cfg->lastLevel; l++) {
+            for (int b = 0; b < cfg->botCount; b++) {
+                BotKind k = cfg->bots[b];
+                SimCell *c = &total->cells[k][l];
+                StatsSummary *won = &total->won[k];
+                long n = won->levels[l].runs;
+                printf("%5d %-7s %5.1f %7.1f %7.2f", l, botNames[k], 100.0 * n / c->runs,
+                       100.0 * c->gaveUp / c->runs, 100.0 * c->unwinnable / c->runs);
+                if (n == 0) {
+                    printf("\n");
+                    continue;
+                }
+                printf(" %6.1f %6d %6d %6.2f %4d %4.1f %4.1f %4.1f %5.1f",
+                       (double)won->levels[l].stepSum / n, statsPercentile(won, l, 0.5), statsPercentile(won, l, 0.99),
+                       (double)c->traps / n, c->maxTraps, (double)c->moods[SAD] / n, (double)c->moods[NEUTRAL] / n,
+                       (double)c->moods[HAPPY] / n, (double)c->xp / n);
+                long scored = c->medals[0] + c->medals[1] + c->medals[2] + c->medals[3];
+                for (int m = 0; m < 4; m++) printf(" %4.1f", scored ? 100.0 * c->medals[m] / scored : 0.0);
+                printf(" %4.1f %4.1f\n", 100.0 * c->levelUps[1] / n, 100.0 * c->levelUps[2] / n);
+            }
+        }
+        for (int b = 0; b < cfg->botCount; b++) {
+            printf("\n%s bot, all levels:", botNames[cfg->bots[b]]);
+            printXPDistribution(&total->won[cfg->bots[b]]);
+            if (total->won[cfg->bots[b]].runs == 0) printf(" no finished runs\n");
+        }
+    }
+    for (int i = 0; i < ready; i++) statsSummaryFree(&cfg->tallies[i / BOT_COUNT].won[i % BOT_COUNT]);
+    free(cfg->tallies);
+    cfg->tallies = NULL;
+    return ok;
+}
+
+// --- Batched environments (psymaze_env.h) ---
+// Every maze's state lives in parallel arrays with one entry per maze (structure of arrays),
+// and the grids, cell indexes, distance fields and routes are packed back to back, maze i at
+// i * total. A step builds Grid, CellIndex and Reach views over maze i's slices, so the game's
+// own processObstacle, morphMaze and route keeping run on them unchanged; the BFS scratch is
+// kept once per thread. Par is not solved, rewards do not need it. A pool of workers that
+// live as long as the PsyEnv steps fixed ranges of mazes, so results do not depend on the
+// thread count, and each batch costs one wake-up per worker.
+#define ENV_OBS_MASK (CELL_OPEN | CELL_OBS_MASK | CELL_VISITED)   // PRESERVE would give the route away
+
+typedef struct {
+    PsyEnv *env;
+    int first, last;          // mazes [first, last)
+    int *queue;               // Reach scratch for one maze
+    long long *order;
+    pthread_t thread;
+} EnvWorker;
+
+struct PsyEnv {
+    PsyEnvConfig cfg;
+    int rows, cols, total;
+    // packed, total entries per maze
+    unsigned char *cells;
+    int *indexCells, *indexPos;
+    int *dist, *route;
+    // one entry per maze
+    int32_t *openCount, *routeHead, *routeEnd;
+    int32_t *x, *y, *steps, *actionCount;
+    int32_t *trapCount, *puzzleCount, *bonusCount;
+    uint8_t *mood, *lastMove;
+    uint32_t *episodes;
+    Rng *moodRng, *morphRng;
+    // the batch being played, set before the workers wake
+    bool resetting;
+    const uint8_t *actions;
+    uint8_t *obs;
+    float *rewards;
+    uint8_t *dones;
+    EnvWorker *workers;
+    int workerCount;          // workers allocated
+    int threads;              // of which running, the calling thread included
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    long generation;          // batches started, under lock
+    int pending;              // workers still on this batch, under lock
+    bool stop;
+};
+
+PsyEnvRewards psyEnvDefaultRewards(void) {
+    return (PsyEnvRewards){-0.01f, -0.05f, -0.5f, 0.1f, 0.1f, 0.2f, 0.05f, 10.0f};
+}
+
+static inline Grid envGrid(PsyEnv *env, int i) {
+    return (Grid){env->rows, env->cols, env->cells + (size_t)i * env->total, NULL, NULL, 0};
+}
+
+static inline CellIndex envIndex(PsyEnv *env, int i) {
+    size_t o = (size_t)i * env->total;
+    return (CellIndex){env->indexCells + o, env->indexPos + o, env->openCount[i], env->total, NULL};
+}
+
+static inline Reach envReach(PsyEnv *env, EnvWorker *w, int i) {
+    size_t o = (size_t)i * env->total;
+    return (Reach){env->dist + o, w->queue, w->order, env->route + o, env->routeHead[i], env->routeEnd[i],
+                   0, env->total - 1, env->total};
+}
+
+// A new maze for episode episodes[i] of maze i, seeded from the config seed, i and the episode
+void envResetOne(PsyEnv *env, EnvWorker *w, int i) {
+    RngStreams rng;
+    rngStreamsSeed(&rng, env->cfg.seed + (uint64_t)i * 0x9E3779B97F4A7C15ull +
+                         (uint64_t)env->episodes[i] * 0xBF58476D1CE4E5B9ull);
+    env->episodes[i]++;
+    Grid g = envGrid(env, i);
+    CellIndex idx = envIndex(env, i);
+    Reach reach = envReach(env, w, i);
+    reach.routeHead = reach.routeEnd = 0;
+    generateMaze(&g, env->rows - 1, env->cols - 1, NULL, &rng.gen, NULL);
+    cellIndexBuild(&idx, &g);
+    placeObstacles(&g, &idx, env->rows - 1, env->cols - 1, env->cfg.level, &rng.obstacles);
+    gridSetFlag(&g, 0, 0, CELL_VISITED);
+    reachFill(&reach, &g);
+    reachUpdateRoute(&reach, &g, 0, 0);
+    env->openCount[i] = idx.openCount;
+    env->routeHead[i] = reach.routeHead;
+    env->routeEnd[i] = reach.routeEnd;
+    env->x[i] = env->y[i] = 0;
+    env->mood[i] = NEUTRAL;
+    env->lastMove[i] = 'd';
+    env->steps[i] = env->actionCount[i] = 0;
+    env->trapCount[i] = env->puzzleCount[i] = env->bonusCount[i] = 0;
+    env->moodRng[i] = rng.mood;
+    env->morphRng[i] = rng.morph;
+}
+
+// One action on maze i, the same rules as sessionStep and sessionJump. Returns the done flag.
+int envStepOne(PsyEnv *env, EnvWorker *w, int i, uint8_t action, float *reward) {
+    const PsyEnvRewards *rw = &env->cfg.rewards;
+    Grid g = envGrid(env, i);
+    int x = env->x[i], y = env->y[i];
+    int newX = x, newY = y;
+    bool moved;
+    *reward = rw->step;
+    if (action == PSY_ACT_JUMP) {
+        char dir = (char)env->lastMove[i];
+        if (dir == 'w') newX -= 2;
+        else if (dir == 's') newX += 2;
+        else if (dir == 'a') newY -= 2;
+        else newY += 2;
+        int midX = (x + newX) / 2, midY = (y + newY) / 2;
+        moved = gridInBounds(&g, newX, newY) && !gridIsOpen(&g, midX, midY) && gridIsOpen(&g, newX, newY) &&
+                gridObstacle(&g, midX, midY) == NONE;
+    } else if (action < PSY_ACT_JUMP) {
+        env->lastMove[i] = (uint8_t)"wsad"[action];
+        newX += (action == PSY_ACT_DOWN) - (action == PSY_ACT_UP);
+        newY += (action == PSY_ACT_RIGHT) - (action == PSY_ACT_LEFT);
+        moved = gridInBounds(&g, newX, newY) && gridIsOpen(&g, newX, newY);
+    } else {
+        moved = false;
+    }
+
+    int done = PSY_ENV_PLAYING;
+    if (!moved) {
+        *reward += rw->invalid;
+    } else {
+        Reach reach = envReach(env, w, i);
+        gridSetFlag(&g, newX, newY, CELL_VISITED);
+        reachUpdateRoute(&reach, &g, newX, newY);
+        env->steps[i]++;
+        Player player = {newX, newY, (Mood)env->mood[i]};
+        int obs = gridObstacle(&g, newX, newY);
+        if (obs == TRAP) *reward += player.mood == HAPPY ? rw->trapAvoided : rw->trapHit;
+        else if (obs == PUZZLE) *reward += rw->puzzle;
+        else if (obs == BONUS) *reward += rw->bonus;
+        else if (obs == POWERUP) *reward += rw->powerup;
+        processObstacle(&player, obs, &env->trapCount[i], &env->puzzleCount[i], &env->bonusCount[i],
+                        env->rows, env->cols);
+        // sessionRollMood: a new mood morphs the maze
+        Mood oldMood = player.mood;
+        player.mood = generateMood(&env->moodRng[i]);
+        if (oldMood != player.mood) {
+            CellIndex idx = envIndex(env, i);
+            morphMaze(&g, &idx, &reach, rules.morphAmount, player, &env->morphRng[i]);
+            env->openCount[i] = idx.openCount;
+        }
+        env->routeHead[i] = reach.routeHead;
+        env->routeEnd[i] = reach.routeEnd;
+        env->x[i] = newX;
+        env->y[i] = newY;
+        env->mood[i] = (uint8_t)player.mood;
+        if (newX == env->rows - 1 && newY == env->cols - 1) {
+            *reward += rw->exit;
+            done = PSY_ENV_EXIT;
+        }
+    }
+    env->actionCount[i]++;
+    if (done == PSY_ENV_PLAYING && env->cfg.maxSteps > 0 && env->actionCount[i] >= env->cfg.maxSteps) {
+        done = PSY_ENV_TRUNCATED;
+    }
+    return done;
+}
+
+// The view around the player, then the mood
+void envObserve(PsyEnv *env, int i, uint8_t *obs) {
+    const unsigned char *cells = env->cells + (size_t)i * env->total;
+    int half = PSY_ENV_VIEW / 2;
+    for (int dx = -half; dx <= half; dx++) {
+        int x = env->x[i] + dx;
+        for (int dy = -half; dy <= half; dy++) {
+            int y = env->y[i] + dy;
+            bool inside = x >= 0 && x < env->rows && y >= 0 && y < env->cols;
+            *obs++ = inside ? cells[x * env->cols + y] & ENV_OBS_MASK : 0;
+        }
+    }
+    *obs = env->mood[i];
+}
+
+void envRange(PsyEnv *env, EnvWorker *w) {
+    for (int i = w->first; i < w->last; i++) {
+        if (env->resetting) {
+            envResetOne(env, w, i);
+        } else {
+            int done = envStepOne(env, w, i, env->actions[i], &env->rewards[i]);
+            env->dones[i] = (uint8_t)done;
+            if (done != PSY_ENV_PLAYING && env->cfg.autoReset) envResetOne(env, w, i);
+        }
+        if (env->obs) envObserve(env, i, env->obs + (size_t)i * PSY_ENV_OBS);
+    }
+}
+
+void *envWorker(void *arg) {
+    EnvWorker *w = (EnvWorker *)arg;
+    PsyEnv *env = w->env;
+    long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&env->lock);
+        while (env->generation == seen && !env->stop) pthread_cond_wait(&env->start, &env->lock);
+        bool stop = env->stop;
+        seen = env->generation;
+        pthread_mutex_unlock(&env->lock);
+        if (stop) return NULL;
+        envRange(env, w);
+        pthread_mutex_lock(&env->lock);
+        if (--env->pending == 0) pthread_cond_signal(&env->done);
+        pthread_mutex_unlock(&env->lock);
+    }
+}
+
+// Plays the current batch: the calling thread takes the first range, the workers the rest
+void envRun(PsyEnv *env) {
+    if (env->threads > 1) {
+        pthread_mutex_lock(&env->lock);
+        env->generation++;
+        env->pending = env->threads - 1;
+        pthread_cond_broadcast(&env->start);
+        pthread_mutex_unlock(&env->lock);
+    }
+    envRange(env, &env->workers[0]);
+    if (env->threads > 1) {
+        pthread_mutex_lock(&env->lock);
+        while (env->pending > 0) pthread_cond_wait(&env->done, &env->lock);
+        pthread_mutex_unlock(&env->lock);
+    }
+}
+
+void psyEnvFree(PsyEnv *env) {
+    if (!env) return;
+    if (env->workers) {
+        pthread_mutex_lock(&env->lock);
+        env->stop = true;
+        pthread_cond_broadcast(&env->start);
+        pthread_mutex_unlock(&env->lock);
+        for (int t = 1; t < env->threads; t++) pthread_join(env->workers[t].thread, NULL);
+        for (int t = 0; t < env->workerCount; t++) {
+            free(env->workers[t].queue);
+            free(env->workers[t].order);
+        }
+        pthread_mutex_destroy(&env->lock);
+        pthread_cond_destroy(&env->start);
+        pthread_cond_destroy(&env->done);
+    }
+    free(env->workers);
+    free(env->cells); free(env->indexCells); free(env->indexPos); free(env->dist); free(env->route);
+    free(env->openCount); free(env->routeHead); free(env->routeEnd);
+    free(env->x); free(env->y); free(env->steps); free(env->actionCount);
+    free(env->trapCount); free(env->puzzleCount); free(env->bonusCount);
+    free(env->mood); free(env->lastMove); free(env->episodes);
+    free(env->moodRng); free(env->morphRng);
+    free(env);
+}
+
+// Turns off every message and journal write of this process: stepping does no I/O
+PsyEnv *psyEnvCreate(const PsyEnvConfig *cfg) {
+    if (cfg->count < 1 || cfg->level < 1 || cfg->level > 50) return NULL;
+    headless = true;
+    journalWrites = false;
+    PsyEnv *env = (PsyEnv *)countedCalloc(1, sizeof(PsyEnv));
+    if (!env) return NULL;
+    env->cfg = *cfg;
+    env->rows = env->cols = levelToSize(cfg->level);
+    env->total = env->rows * env->cols;
+    size_t n = (size_t)cfg->count, cells = n * env->total;
+    env->cells = (unsigned char *)countedMalloc(cells);
+    env->indexCells = (int *)countedMalloc(cells * sizeof(int));
+    env->indexPos = (int *)countedMalloc(cells * sizeof(int));
+    env->dist = (int *)countedMalloc(cells * sizeof(int));
+    env->route = (int *)countedMalloc(cells * sizeof(int));
+    env->openCount = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->routeHead = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->routeEnd = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->x = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->y = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->steps = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->actionCount = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->trapCount = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->puzzleCount = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->bonusCount = (int32_t *)countedCalloc(n, sizeof(int32_t));
+    env->mood = (uint8_t *)countedCalloc(n, 1);
+    env->lastMove = (uint8_t *)countedCalloc(n, 1);
+    env->episodes = (uint32_t *)countedCalloc(n, sizeof(uint32_t));
+    env->moodRng = (Rng *)countedCalloc(n, sizeof(Rng));
+    env->morphRng = (Rng *)countedCalloc(n, sizeof(Rng));
+    int threads = cfg->threads > 0 ? cfg->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > cfg->count) threads = cfg->count;
+    env->workers = (EnvWorker *)countedCalloc(threads, sizeof(EnvWorker));
+    if (!env->cells || !env->indexCells || !env->indexPos || !env->dist || !env->route || !env->openCount ||
+        !env->routeHead || !env->routeEnd || !env->x || !env->y || !env->steps || !env->actionCount ||
+        !env->trapCount || !env->puzzleCount || !env->bonusCount || !env->mood || !env->lastMove ||
+        !env->episodes || !env->moodRng || !env->morphRng || !env->workers) {
+        free(env->workers);
+        env->workers = NULL;
+        psyEnvFree(env);
+        return NULL;
+    }
+    pthread_mutex_init(&env->lock, NULL);
+    pthread_cond_init(&env->start, NULL);
+    pthread_cond_init(&env->done, NULL);
+    env->workerCount = threads;
+    env->threads = 1;
+    for (int t = 0; t < threads; t++) {
+        EnvWorker *w = &env->workers[t];
+        w->env = env;
+        w->first = (int)((long)cfg->count * t / threads);
+        w->last = (int)((long)cfg->count * (t + 1) / threads);
+        w->queue = (int *)countedMalloc((size_t)env->total * sizeof(int));
+        w->order = (long long *)countedMalloc((size_t)env->total * sizeof(long long));
+        if (!w->queue || !w->order) {
+            psyEnvFree(env);
+            return NULL;
+        }
+    }
+    // mazes never share state, so if a worker cannot start the last running one takes the rest
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&env->workers[t].thread, NULL, envWorker, &env->workers[t]) != 0) {
+            env->workers[t - 1].last = cfg->count;
+            break;
+        }
+        env->threads++;
+    }
+    psyEnvReset(env, NULL);
+    return env;
+}
+
+void psyEnvReset(PsyEnv *env, uint8_t *obs) {
+    env->resetting = true;
+    env->obs = obs;
+    envRun(env);
+    env->resetting = false;
+}
+
+void psyEnvStep(PsyEnv *env, const uint8_t *actions, uint8_t *obs, float *rewards, uint8_t *dones) {
+    env->actions = actions;
+    env->obs = obs;
+    env->rewards = rewards;
+    env->dones = dones;
+    envRun(env);
+}
+
+PsyEnvState psyEnvState(const PsyEnv *env) {
+    return (PsyEnvState){env->x, env->y, env->mood, env->steps, env->trapCount, env->puzzleCount,
+                         env->bonusCount, env->episodes, env->cells, env->rows, env->cols};
+}
+
+#ifdef PSYMAZE_BENCH
+// --- Headless benchmark build ---
+// gcc -O2 -DPSYMAZE_BENCH initial.c -o psymaze_bench
+// Runs every phase for levels 1-50 plus custom sizes with a fixed seed, writes a TSV
+// baseline and can compare a fresh run against an older baseline.
+
+#define BENCH_SEED 20240601u
+#define BENCH_MAX_RESULTS 1024
+#define BENCH_MAX_SIZES 16
+
+typedef struct {
+    char phase[16];
+    int level;              // 0 for custom sizes
+    int rows, cols;
+    long iters;
+    double nsPerOp;
+    double nsPerCell;
+    double cellsPerSec;
+    double allocsPerOp;
+} BenchResult;
+
+BenchResult benchResults[BENCH_MAX_RESULTS];
+int benchCount = 0;
+
+// Silence stdout while timing the renderer, returns the saved descriptor
+int benchMuteStdout() {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    return saved;
+}
+
+void benchRestoreStdout(int saved) {
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+void benchRecord(const char *phase, int level, int rows, int cols,
+                 long iters, double millis, unsigned long allocs) {
+    if (benchCount == BENCH_MAX_RESULTS) return;
+    BenchResult *r = &benchResults[benchCount++];
+    double cells = (double)rows * cols * iters;
+    snprintf(r->phase, sizeof(r->phase), "%s", phase);
+    r->level = level;
+    r->rows = rows;
+    r->cols = cols;
+    r->iters = iters;
+    r->nsPerOp = millis * 1e6 / iters;
+    r->nsPerCell = millis * 1e6 / cells;
+    r->cellsPerSec = millis > 0 ? cells / (millis / 1000.0) : 0;
+    r->allocsPerOp = (double)allocs / iters;
+    printf("%-10s L%-3d %6d x %-6d %8ld ops %12.1f ns/op %8.3f ns/cell %10.3g cells/s %6.2f allocs/op\n",
+           r->phase, level, rows, cols, iters, r->nsPerOp, r->nsPerCell, r->cellsPerSec, r->allocsPerOp);
+}
+
+// Enough repetitions that small mazes still take measurable time
+long benchIters(int rows, int cols, double cellBudget) {
+    long iters = (long)(cellBudget / ((double)rows * cols));
+    return iters < 1 ? 1 : iters;
+}
+
+typedef struct {
+    Grid grid;
+    CellIndex cells;
+    Reach reach;
+    NPCIndex npcIndex;
+    NPCIndex crowd;         // 1000 NPCs for the lookup phase
+    Player player;
+    int exitX, exitY;
+    int obstacleLevel;
+    GenConfig gen;
+    RngStreams rng;
+    Renderer renderer;
+    Solver solver;
+    BitBfs bits;
+    int *dist;              // distance field for both BFS phases
+    Session *session;       // for the step phases
+    Autosave *autosave;     // steps-autosave writes a delta after every move
+    StatsRecord *stats;     // stats-scan records, grid.cols of them
+    Arena arena;            // next-arena levels
+    long found;             // keeps the lookups from being optimized away
+} BenchCtx;
+
+// One operation of a phase, i is the iteration number
+typedef void (*BenchPhaseFn)(BenchCtx *ctx, long i);
+
+void benchGenerate(BenchCtx *ctx, long i)  { (void)i; generateMaze(&ctx->grid, ctx->exitX, ctx->exitY, NULL, &ctx->rng.gen, NULL); }
+// every thread count carves the same maze
+void benchTiled(BenchCtx *ctx, long i) {
+    (void)i;
+    Rng rng;
+    rngSeed(&rng, BENCH_SEED, 1);
+    generateMaze(&ctx->grid, ctx->exitX, ctx->exitY, &ctx->gen, &rng, NULL);
+}
+void benchCellIndex(BenchCtx *ctx, long i) { (void)i; cellIndexBuild(&ctx->cells, &ctx->grid); }
+void benchReachBuild(BenchCtx *ctx, long i) {
+    (void)i;
+    reachFree(&ctx->reach);
+    reachBuild(&ctx->reach, &ctx->grid, ctx->exitX, ctx->exitY, NULL);
+}
+void benchObstacles(BenchCtx *ctx, long i) {
+    (void)i;
+    placeObstacles(&ctx->grid, &ctx->cells, ctx->exitX, ctx->exitY, ctx->obstacleLevel, &ctx->rng.obstacles);
+}
+void benchNPCs(BenchCtx *ctx, long i)      { (void)i; initNPCs(&ctx->npcIndex, &ctx->grid, &ctx->cells, &ctx->rng.npc); }
+void benchNPCLookup(BenchCtx *ctx, long i) {
+    // deterministic walk over the grid, most probes land on tiles without an NPC
+    long cell = (i * 7919) % ((long)ctx->grid.rows * ctx->grid.cols);
+    ctx->found += npcFirstAt(&ctx->crowd, &ctx->grid, (int)(cell / ctx->grid.cols), (int)(cell % ctx->grid.cols)) >= 0;
+}
+void benchMorph(BenchCtx *ctx, long i) {
+    ctx->player.mood = (Mood)(i % 3);
+    morphMaze(&ctx->grid, &ctx->cells, &ctx->reach, 3, ctx->player, &ctx->rng.morph);
+}
+void benchSolve(BenchCtx *ctx, long i) {
+    (void)i;
+    ctx->found += solveMaze(&ctx->solver, &ctx->grid, 0, 0, ctx->exitX, ctx->exitY);
+}
+// One level start as the game makes it (maze, cell index, obstacles, NPCs, route and par), on
+// the heap and freed again, or reset over the previous one in the arena as a campaign does
+void benchNextHeap(BenchCtx *ctx, long i) {
+    Session s;
+    if (sessionGenerate(&s, ctx->obstacleLevel, ctx->grid.rows, ctx->grid.cols, NULL, BENCH_SEED + i, NULL)) {
+        sessionPopulate(&s, 3);
+    }
+    sessionFree(&s);
+}
+void benchNextArena(BenchCtx *ctx, long i) {
+    Session s;
+    if (arenaReset(&ctx->arena, sessionArenaBytes(ctx->grid.rows, ctx->grid.cols, 3)) &&
+        sessionGenerateIn(&s, &ctx->arena, ctx->obstacleLevel, ctx->grid.rows, ctx->grid.cols, NULL,
+                          BENCH_SEED + i, NULL)) {
+        sessionPopulate(&s, 3);
+    }
+}
+// Plain queue BFS from the exit, the reference the bit-parallel kernel is measured against
+void benchQueueBfs(BenchCtx *ctx, long i) {
+    (void)i;
+    Grid *g = &ctx->grid;
+    int total = g->rows * g->cols, head = 0, tail = 0;
+    int *queue = ctx->reach.queue;
+    for (int c = 0; c < total; c++) ctx->dist[c] = REACH_INF;
+    queue[tail++] = ctx->exitX * g->cols + ctx->exitY;
+    ctx->dist[queue[0]] = 0;
+    while (head < tail) {
+        int u = queue[head++];
+        for (int d = 0; d < 4; d++) {
+            int v = reachNeighbour(g, u, d);
+            if (v < 0 || !(g->cells[v] & CELL_OPEN) || ctx->dist[v] != REACH_INF) continue;
+            ctx->dist[v] = ctx->dist[u] + 1;
+            queue[tail++] = v;
+        }
+    }
+    ctx->found += tail;
+}
+void benchBitBfs(BenchCtx *ctx, long i) {
+    (void)i;
+    bitBfsLoad(&ctx->bits, &ctx->grid);
+    ctx->found += bitBfsRun(&ctx->bits, ctx->exitX, ctx->exitY, ctx->dist);
+}
+// reachability mask only, what bulk maze analysis needs most
+void benchBitReach(BenchCtx *ctx, long i) {
+    (void)i;
+    bitBfsLoad(&ctx->bits, &ctx->grid);
+    ctx->found += bitBfsReach(&ctx->bits, ctx->exitX, ctx->exitY);
+}
+// one random key of play, journal entries and all
+void benchStep(BenchCtx *ctx, long i) {
+    (void)i;
+    static const char keys[] = "wasdwasdj";
+    StepResult result = sessionStep(ctx->session, keys[rngBelow(&ctx->rng.ui, sizeof(keys) - 1)]);
+    if (ctx->autosave && (result == STEP_MOVED || result == STEP_MET_NPC)) autosaveAfterMove(ctx->autosave, ctx->session);
+    ctx->found += result;
+}
+void benchStatsScan(BenchCtx *ctx, long i) {
+    (void)i;
+    StatsSummary s;
+    if (statsScan(ctx->stats, ctx->grid.cols, 1, &s)) {
+        ctx->found += statsPercentile(&s, 20, 0.99);
+        statsSummaryFree(&s);
+    }
+}
+void benchLesson(BenchCtx *ctx, long i) {
+    (void)ctx; (void)i;
+    logLifeLesson("You faced a puzzle: complex situations can shift how you feel and think.");
+}
+void benchRender(BenchCtx *ctx, long i) {
+    (void)i;
+    printMazeGeneric(&ctx->renderer, &ctx->grid, ctx->player.x, ctx->player.y, ctx->exitX, ctx->exitY);
+}
+// player steps back and forth, so each frame after the first repaints a couple of cells
+void benchRenderDiff(BenchCtx *ctx, long i) {
+    ctx->player.y = (int)(i % 2);
+    printMazeGeneric(&ctx->renderer, &ctx->grid, ctx->player.x, ctx->player.y, ctx->exitX, ctx->exitY);
+}
+
+// Times the phase BENCH_REPEATS times and keeps the fastest batch to cut scheduler noise
+#define BENCH_REPEATS 3
+void benchRun(const char *phase, BenchCtx *ctx, int level, long iters, BenchPhaseFn fn, bool muteStdout) {
+    double best = -1;
+    unsigned long allocs = 0;
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        int saved = muteStdout ? benchMuteStdout() : -1;
+        unsigned long before = allocCalls;
+        double start = nowMillis();
+        for (long i = 0; i < iters; i++) fn(ctx, i);
+        if (muteStdout) fflush(stdout);
+        double millis = nowMillis() - start;
+        if (muteStdout) benchRestoreStdout(saved);
+        if (best < 0 || millis < best) best = millis;
+        allocs = allocCalls - before;
+    }
+    benchRecord(phase, level, ctx->grid.rows, ctx->grid.cols, iters, best, allocs);
+}
+
+void benchOneSize(int level, int rows, int cols, int obstacleLevel) {
+    BenchCtx ctx;
+    if (!gridInit(&ctx.grid, rows, cols)) {
+        printf("Not enough memory for a %d x %d maze, skipped.\n", rows, cols);
+        return;
+    }
+    ctx.exitX = rows - 1;
+    ctx.exitY = cols - 1;
+    ctx.obstacleLevel = obstacleLevel;
+    ctx.player = (Player){0, 0, NEUTRAL};
+    rngStreamsSeed(&ctx.rng, BENCH_SEED);
+
+    long iters = benchIters(rows, cols, 2e6);
+    benchRun("generate", &ctx, level, iters, benchGenerate, false);
+    ctx.cells = (CellIndex){0};
+    benchRun("cell-index", &ctx, level, iters, benchCellIndex, false);
+    ctx.reach = (Reach){0};
+    benchRun("reach-build", &ctx, level, iters, benchReachBuild, false);
+    reachUpdateRoute(&ctx.reach, &ctx.grid, 0, 0);
+    benchRun("obstacles", &ctx, level, iters, benchObstacles, false);
+    if (npcIndexInit(&ctx.npcIndex, 3, rows, cols, NULL) && npcIndexInit(&ctx.crowd, 1000, rows, cols, NULL)) {
+        benchRun("npcs", &ctx, level, 10000, benchNPCs, false);
+        initNPCs(&ctx.crowd, &ctx.grid, &ctx.cells, &ctx.rng.npc);
+        benchRun("npc-lookup", &ctx, level, 1000000, benchNPCLookup, false);
+        npcIndexClear(&ctx.crowd, &ctx.grid);   // the render phases show the 3 regular NPCs
+        npcIndexFree(&ctx.crowd);
+    }
+    benchRun("morph", &ctx, level, 100000, benchMorph, false);
+    ctx.solver = (Solver){0};
+    benchRun("solve", &ctx, level, benchIters(rows, cols, 2e6), benchSolve, false);
+    ctx.arena = (Arena){0};
+    benchRun("next-heap", &ctx, level, benchIters(rows, cols, 2e6), benchNextHeap, false);
+    benchRun("next-arena", &ctx, level, benchIters(rows, cols, 2e6), benchNextArena, false);
+    arenaFree(&ctx.arena);
+    ctx.bits = (BitBfs){0};
+    ctx.dist = (int *)countedMalloc((size_t)rows * cols * sizeof(int));
+    if (ctx.dist && bitBfsInit(&ctx.bits, rows, cols)) {
+        benchRun("bfs-queue", &ctx, level, benchIters(rows, cols, 2e6), benchQueueBfs, false);
+        benchRun("bfs-bits", &ctx, level, benchIters(rows, cols, 2e6), benchBitBfs, false);
+        benchRun("reach-bits", &ctx, level, benchIters(rows, cols, 2e6), benchBitReach, false);
+    }
+    bitBfsFree(&ctx.bits);
+    free(ctx.dist);
+    long renderIters = benchIters(rows, cols, 5e5);
+    if (rendererInit(&ctx.renderer, rows, cols, true)) {
+        benchRun("render", &ctx, level, renderIters, benchRender, true);
+        size_t fullBytes = ctx.renderer.lastBytes;
+        ctx.renderer.ansi = true;              // stdout is /dev/null here, pretend it is a big terminal
+        ctx.renderer.screenRows = rows + RENDER_MESSAGE_LINES;
+        benchRun("render-diff", &ctx, level, renderIters * 20, benchRenderDiff, true);
+        printf("%-10s bytes/frame: full %zu, diff %zu\n", "", fullBytes, ctx.renderer.lastBytes);
+    }
+    rendererFree(&ctx.renderer);
+    // full frames for a 50 x 160 terminal with the minimap: the same cost on every maze size
+    if (rendererInit(&ctx.renderer, rows, cols, false)) {
+        ctx.renderer.ansi = false;
+        if (rendererResize(&ctx.renderer, 50, 160) && rendererSetMinimap(&ctx.renderer, &ctx.grid, true)) {
+            benchRun("render-view", &ctx, level, 2000, benchRender, true);
+            printf("%-10s bytes/frame: view %d x %d, minimap %d x %d, %zu\n", "", ctx.renderer.viewRows,
+                   ctx.renderer.viewCols, ctx.renderer.map.blockRows, ctx.renderer.map.blockCols,
+                   ctx.renderer.lastBytes);
+        }
+    }
+    rendererFree(&ctx.renderer);
+
+    // custom sizes also time the tiled generator from 1 thread up to every core
+    if (level == 0) {
+        int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        for (int threads = 1; ; threads *= 2) {
+            if (threads > cores) threads = cores;
+            char phase[16];
+            snprintf(phase, sizeof(phase), "tiled-t%d", threads);
+            ctx.gen = (GenConfig){GEN_TILED, threads, NULL, 0};
+            benchRun(phase, &ctx, level, iters, benchTiled, false);
+            if (threads >= cores) break;
+        }
+    }
+
+    solverFree(&ctx.solver);
+    npcIndexFree(&ctx.npcIndex);
+    cellIndexFree(&ctx.cells);
+    reachFree(&ctx.reach);
+    gridFree(&ctx.grid);
+}
+
+// Steps per second of a level 20 session with the journal off, written one open/append/close
+// per entry as before, through the journal writer, and with the journal off but an autosave
+// delta after every move. Every phase starts the same session and plays the same keys.
+void benchJournal() {
+    const char *phases[4] = {"steps-nolog", "steps-sync", "steps-async", "steps-autosave"};
+    GenConfig gen = {GEN_DFS, 1, NULL, 0};
+    int size = levelToSize(20);
+    headless = true;
+    journalFile = "bench_journal.txt";
+    autosaveBase = "bench_autosave.bin";
+    autosaveLog = "bench_autosave.log";
+    for (int mode = 0; mode < 4; mode++) {
+        Session session;
+        if (!sessionGenerate(&session, 20, size, size, &gen, BENCH_SEED, NULL) || !sessionPopulate(&session, 3)) {
+            printf("Not enough memory for the step benchmark, skipped.\n");
+            sessionFree(&session);
+            break;
+        }
+        BenchCtx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.grid = session.grid;    // only read for the maze size
+        ctx.session = &session;
+        rngStreamsSeed(&ctx.rng, BENCH_SEED);
+        journalWrites = mode == 1 || mode == 2;
+        Autosave autosave = {0};
+        if (mode == 3) {
+            if (!autosaveStart(&autosave, &session, (AutosaveConfig){1, false})) {
+                printf("Could not start autosave, skipped.\n");
+                sessionFree(&session);
+                break;
+            }
+            ctx.autosave = &autosave;
+        }
+        if (mode == 2 && !journalOpen(&journal, journalFile, (JournalConfig){32, 250, true, 0})) {
+            printf("Could not start the journal writer, skipped.\n");
+            sessionFree(&session);
+            break;
+        }
+        benchRun(phases[mode], &ctx, 20, 1000, benchStep, false);
+        bool lessons = mode == 1 || mode == 2;
+        if (lessons) benchRun(mode == 1 ? "lesson-sync" : "lesson-async", &ctx, 20, 20000, benchLesson, false);
+        journalClose(&journal);
+        printf("%-10s %.0f steps/s\n", "", 1e9 / benchResults[benchCount - (lessons ? 2 : 1)].nsPerOp);
+        if (mode == 3) printf("%-10s %ld deltas, %.1f KB log\n", "", autosave.records, autosave.logBytes / 1024.0);
+        autosaveStop(&autosave, &session, true);
+        sessionFree(&session);
+    }
+    if (journal.fullWaits > 0) printf("%-10s journal ring was full %ld times\n", "", journal.fullWaits);
+    remove(journalFile);
+    remove("bench_journal.txt.idx");
+    journalFile = JOURNAL_FILE;
+    autosaveBase = AUTOSAVE_BASE;
+    autosaveLog = AUTOSAVE_LOG;
+    journalWrites = true;
+    headless = false;
+}
+
+// One thread scanning a million stats records in memory, ns/cell is ns per record
+void benchStats() {
+    long count = 1000000;
+    BenchCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.stats = (StatsRecord *)countedCalloc(count, sizeof(StatsRecord));
+    if (!ctx.stats) {
+        printf("Not enough memory for the stats benchmark, skipped.\n");
         return;
     }
+    rngStreamsSeed(&ctx.rng, BENCH_SEED);
+    for (long i = 0; i < count; i++) {
+        StatsRecord *r = &ctx.stats[i];
+        r->level = 1 + rngBelow(&ctx.rng.gen, 50);
+        r->steps = levelToSize(r->level) * (2 + rngBelow(&ctx.rng.gen, 6));
+        r->xp = rngBelow(&ctx.rng.gen, STATS_XP_MAX + 1);
+    }
+    ctx.grid.rows = 1;
+    ctx.grid.cols = (int)count;
+    benchRun("stats-scan", &ctx, 0, 5, benchStatsScan, false);
+    free(ctx.stats);
+}
 
-    fprintf(f, "=== New Session ===\n");
-    fprintf(f, "Steps: %d\n", steps);
-    fprintf(f, "Moods: Sad=%d Neutral=%d Happy=%d\n",
-            moodCounts[SAD], moodCounts[NEUTRAL], moodCounts[HAPPY]);
-    fprintf(f, "Obstacles: Traps=%d Puzzles=%d Bonuses=%d\n",
-            trapCount, puzzleCount, bonusCount);
-    fprintf(f, "Philosophy uses: %d\n\n", philosophyUses);
+// 4096 level 10 mazes stepped with random actions, on one thread and on every core; one op is
+// one maze stepped once
+void benchEnv() {
+    int threadCounts[2] = {1, 0};
+    const char *phases[2] = {"env-serial", "env-step"};
+    int count = 4096, batches = 100;
+    bool savedJournal = journalWrites;
+    uint8_t *actions = (uint8_t *)countedMalloc(count);
+    uint8_t *obs = (uint8_t *)countedMalloc((size_t)count * PSY_ENV_OBS);
+    uint8_t *dones = (uint8_t *)countedMalloc(count);
+    float *rewards = (float *)countedMalloc((size_t)count * sizeof(float));
+    for (int t = 0; t < 2 && actions && obs && dones && rewards; t++) {
+        PsyEnvConfig cfg = {count, 10, threadCounts[t], 2000, true, BENCH_SEED, psyEnvDefaultRewards()};
+        PsyEnv *env = psyEnvCreate(&cfg);
+        if (!env) break;
+        Rng rng;
+        rngSeed(&rng, BENCH_SEED, 7);
+        unsigned long before = allocCalls;
+        double start = nowMillis();
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < count; i++) actions[i] = (uint8_t)rngBelow(&rng, PSY_ACTIONS);
+            psyEnvStep(env, actions, obs, rewards, dones);
+        }
+        double millis = nowMillis() - start;
+        benchRecord(phases[t], 10, env->rows, env->cols, (long)count * batches, millis, allocCalls - before);
+        psyEnvFree(env);
+    }
+    if (!actions || !obs || !dones || !rewards) printf("Not enough memory for the env benchmark, skipped.\n");
+    free(actions);
+    free(obs);
+    free(dones);
+    free(rewards);
+    journalWrites = savedJournal;
+}
 
+bool benchWriteBaseline(const char *filename) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        printf("Could not open baseline file %s.\n", filename);
+        return false;
+    }
+    fprintf(f, "# psymaze-bench v1 seed=%u\n", BENCH_SEED);
+    fprintf(f, "# phase\tlevel\trows\tcols\titers\tns_per_op\tns_per_cell\tcells_per_sec\tallocs_per_op\n");
+    for (int i = 0; i < benchCount; i++) {
+        BenchResult *r = &benchResults[i];
+        fprintf(f, "%s\t%d\t%d\t%d\t%ld\t%.3f\t%.6f\t%.6g\t%.3f\n", r->phase, r->level, r->rows, r->cols,
+                r->iters, r->nsPerOp, r->nsPerCell, r->cellsPerSec, r->allocsPerOp);
+    }
     fclose(f);
+    printf("Results written to %s\n", filename);
+    return true;
 }
 
-int showAchievementsAndComputeXP(int steps,
-                                 int moodCounts[3],
-                                 int trapCount, int puzzleCount, int bonusCount,
-                                 int philosophyUses) {
-    int xp = 0;
+// Flags every phase/size that got slower than the baseline by more than thresholdPct.
+// Returns the number of regressions, or -1 if the baseline cannot be read.
+int benchCompare(const char *filename, double thresholdPct) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        printf("Could not open baseline file %s.\n", filename);
+        return -1;
+    }
+    char line[MAX_LINE_LEN];
+    int regressions = 0, matched = 0;
+    printf("\n===== Comparison against %s (threshold %.1f%%) =====\n", filename, thresholdPct);
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        BenchResult old;
+        if (sscanf(line, "%15s %d %d %d %ld %lf %lf %lf %lf", old.phase, &old.level, &old.rows, &old.cols,
+                   &old.iters, &old.nsPerOp, &old.nsPerCell, &old.cellsPerSec, &old.allocsPerOp) != 9) continue;
+        for (int i = 0; i < benchCount; i++) {
+            BenchResult *r = &benchResults[i];
+            if (strcmp(r->phase, old.phase) != 0 || r->rows != old.rows || r->cols != old.cols) continue;
+            matched++;
+            double change = (r->nsPerOp / old.nsPerOp - 1.0) * 100.0;
+            bool slower = change > thresholdPct;
+            bool moreAllocs = r->allocsPerOp > old.allocsPerOp + 0.5;
+            if (slower || moreAllocs) {
+                regressions++;
+                printf("REGRESSION %-10s %6d x %-6d %+7.1f%% time, allocs/op %.2f -> %.2f\n",
+                       r->phase, r->rows, r->cols, change, old.allocsPerOp, r->allocsPerOp);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    printf("%d results compared, %d regressions\n", matched, regressions);
+    return regressions;
+}
 
-    printf("\n===== ACHIEVEMENTS =====\n");
+// True when both names lead to the same file, so writing one would overwrite the other
+bool benchSameFile(const char *a, const char *b) {
+    struct stat sa, sb;
+    if (strcmp(a, b) == 0) return true;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
 
-    if (steps < 50) {
-        printf("Efficient Explorer (finished in under 50 steps)\n");
-        xp += 30;
-    } else if (steps > 200) {
-        printf("Persistent Wanderer (kept going despite a long path)\n");
-        xp += 20;
+int main(int argc, char **argv) {
+    const char *outFile = "bench_baseline.tsv";
+    const char *compareFile = NULL;
+    bool outGiven = false;
+    double threshold = 10.0;
+    int sizes[BENCH_MAX_SIZES] = {501, 1001, 2001};
+    int sizeCount = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outFile = argv[++i];
+            outGiven = true;
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            compareFile = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            // comma separated list, e.g. --sizes 1001,4001,10001
+            sizeCount = 0;
+            for (char *tok = strtok(argv[++i], ","); tok && sizeCount < BENCH_MAX_SIZES; tok = strtok(NULL, ",")) {
+                int n = atoi(tok);
+                if (n >= 3) sizes[sizeCount++] = n | 1;
+            }
+        } else {
+            printf("Usage: %s [--out FILE] [--compare BASELINE] [--threshold PCT] [--sizes N,N,...]\n", argv[0]);
+            return 1;
+        }
     }
 
-    if (moodCounts[HAPPY] > moodCounts[SAD]) {
-        printf("Bringer of Light (more happy moods than sad)\n");
-        xp += 20;
+    // comparing against the default output compares without writing; an explicit --out must differ
+    bool write = !compareFile || !benchSameFile(outFile, compareFile);
+    if (!write && outGiven) {
+        printf("--out and --compare name the same file %s; the baseline would be overwritten.\n", outFile);
+        return 1;
     }
 
-    if (philosophyUses >= 3) {
-        printf("Reflective Seeker (used philosophy support 3+ times)\n");
-        xp += 25;
+    for (int level = 1; level <= 50; level++) {
+        int size = levelToSize(level);
+        benchOneSize(level, size, size, level);
     }
+    for (int i = 0; i < sizeCount; i++) benchOneSize(0, sizes[i], sizes[i], 50);
+    benchJournal();
+    benchStats();
+    benchEnv();
 
-    if (puzzleCount >= 2) {
-        printf("Riddle Breaker (solved multiple puzzles)\n");
-        xp += 15;
+    int regressions = compareFile ? benchCompare(compareFile, threshold) : 0;
+    if (write && !benchWriteBaseline(outFile)) return 1;
+    return regressions == 0 ? 0 : 1;
+}
+
+#elif !defined(PSYMAZE_LIB)
+
+// 'S': saves the run for --resume
+void saveRun(const Session *s) {
+    double start = nowMillis();
+    if (saveSnapshot(SNAPSHOT_FILE, s)) {
+        say("Run saved to %s in %.2f ms (continue later with --resume %s)\n",
+            SNAPSHOT_FILE, nowMillis() - start, SNAPSHOT_FILE);
     }
+}
 
-    if (trapCount == 0) {
-        printf("Untouched by Traps (avoided all traps)\n");
-        xp += 30;
+// --- Raw-mode game loop ---
+// poll() waits for keys or for the next frame slot, whichever is due first. Every key that
+// arrives is applied at once; the screen is redrawn at most fps times a second, so a burst
+// of keys costs one frame. Latency is measured from the moment a key was read to the moment
+// the frame showing it was written, for the oldest key in that frame.
+#define LATENCY_BIN_US 10
+#define LATENCY_BINS 10000        // 10 us bins up to 100 ms, slower frames are counted apart
+#define MESSAGE_LINES 6           // latest message lines shown under the maze
+
+typedef struct {
+    long frames;
+    long bins[LATENCY_BINS];
+    long slow;
+    double sumMillis, maxMillis, lastMillis;
+} LatencyStats;
+
+void latencyAdd(LatencyStats *l, double millis) {
+    long bin = (long)(millis * 1000.0 / LATENCY_BIN_US);
+    if (bin < LATENCY_BINS) l->bins[bin >= 0 ? bin : 0]++;
+    else l->slow++;
+    l->frames++;
+    l->sumMillis += millis;
+    l->lastMillis = millis;
+    if (millis > l->maxMillis) l->maxMillis = millis;
+}
+
+// Upper edge of the bin holding the p-th fraction of frames, in ms
+double latencyPercentile(const LatencyStats *l, double p) {
+    long rank = (long)(p * l->frames), seen = 0;
+    if (rank < p * l->frames || rank < 1) rank++;
+    for (int b = 0; b < LATENCY_BINS; b++) {
+        seen += l->bins[b];
+        if (seen >= rank) return (b + 1) * LATENCY_BIN_US / 1000.0;
     }
+    return l->maxMillis;
+}
 
-    if (trapCount > 0 && moodCounts[SAD] > 0) {
-        printf("Resilient Soul (kept going despite traps and sadness)\n");
-        xp += 15;
+typedef struct {
+    const char *text;     // NULL when hidden
+    bool exercise;
+    const char *title;    // NULL for a quote or an exercise
+} Overlay;
+
+// A quote or an exercise, with the same draws showRandomPhilosophySupport makes
+const char *drawPhilosophy(Rng *rng, bool *exercise) {
+    *exercise = rngBelow(rng, 2) == 1;
+    return *exercise ? philosophyExercises[rngBelow(rng, NUM_EXERCISES)] : philosophyQuotes[rngBelow(rng, NUM_QUOTES)];
+}
+
+// Prints the last MESSAGE_LINES lines the keys since the previous frame said, then forgets them
+void printMessages() {
+    size_t end = sayLen;
+    while (end > 0 && sayBuffer[end - 1] == '\n') end--;
+    size_t start = end;
+    for (int lines = 0; start > 0; start--) {
+        if (sayBuffer[start - 1] == '\n' && ++lines == MESSAGE_LINES) break;
+    }
+    while (start < end && sayBuffer[start] == '\n') start++;
+    if (start < end) printf("%.*s\n", (int)(end - start), sayBuffer + start);
+    sayLen = 0;
+}
+
+void drawRawFrame(Renderer *r, const Session *s, const Overlay *overlay, const LatencyStats *latency,
+                  bool renderStats) {
+    printMazeGeneric(r, &s->grid, s->player.x, s->player.y, s->exitX, s->exitY);
+    printf("Position (%d, %d)   Mood %s   Steps %d (par %d)\n", s->player.x, s->player.y,
+           moodFaces[s->player.mood], s->steps, s->par);
+    if (overlay->text) {
+        const char *title = overlay->exercise ? "Philosophical Exercise (r to answer)" : "Philosophical Quote";
+        printf("--- %s ---\n%s\n", overlay->title ? overlay->title : title, overlay->text);
     }
+    printMessages();
+    if (renderStats) {
+        printf("[frame %ld: %zu bytes in %.0f us, key to screen %.2f ms]\n", r->frames, r->lastBytes,
+               r->lastMicros, latency->lastMillis);
+    }
+    printf("w/a/s/d or arrows move, j jump, h quote, x hide it, l journal, S save, m minimap, P profile, q quit");
+    fflush(stdout);
+}
 
-    printf("Total XP this run: %d\n", xp);
-    printf("========================\n");
+// What a key did: the time a prompt spends waiting for the player is not latency
+typedef enum { KEY_QUIT, KEY_PLAYED, KEY_PROMPTED } KeyOutcome;
 
-    return xp;
+KeyOutcome rawKey(Session *s, char key, Renderer *r, Overlay *overlay, Autosave *autosave) {
+    if (key == 'q' || key == 0x03 || key == 0x04) return KEY_QUIT;     // q, Ctrl-C, Ctrl-D
+    if ((unsigned char)key < 0x20 || key == 0x7F) return KEY_PLAYED;
+    if (key == 'x') {
+        overlay->text = NULL;
+        return KEY_PLAYED;
+    }
+    if (key == 'm') {
+        rendererSetMinimap(r, &s->grid, !r->minimap);
+        return KEY_PLAYED;
+    }
+    if (key == 'P') {
+        static char table[2048];
+        profileFormat(table, sizeof(table));
+        *overlay = (Overlay){table, false, "Profile (x to hide)"};
+        rendererInvalidate(r);
+        return KEY_PLAYED;
+    }
+    if (key == 'r') {
+        if (!overlay->exercise || !overlay->text) return KEY_PLAYED;
+        char answer[256];
+        printf("\nYour reflection: ");
+        fflush(stdout);
+        if (readTextLine(answer, sizeof(answer))) {
+            keyLogText(answer);
+            logLifeLesson("Player completed a philosophical exercise and reflected on their journey.");
+            say("Thanks for sharing. Even small reflections can change how you move in the maze and in life.\n");
+        }
+        overlay->text = NULL;
+        rendererInvalidate(r);
+        return KEY_PROMPTED;
+    }
+    keyLogKey(key);
+    if (key == 'l') {
+        terminalRestore();
+        showJournal();
+        terminalRaw();
+        rendererInvalidate(r);
+        return KEY_PROMPTED;
+    }
+    if (key == 'S') {
+        saveRun(s);
+        return KEY_PLAYED;
+    }
+    StepResult result = sessionStep(s, key);
+    if (key == 'h') {
+        overlay->text = drawPhilosophy(&s->rng.ui, &overlay->exercise);
+        overlay->title = NULL;
+        rendererInvalidate(r);    // the overlay can be taller than the space it leaves
+    }
+    if (result == STEP_MOVED || result == STEP_MET_NPC) autosaveAfterMove(autosave, s);
+    if (result == STEP_MET_NPC) {
+        rendererInvalidate(r);
+        return KEY_PROMPTED;    // the NPC asked for a reflection
+    }
+    return KEY_PLAYED;
 }
 
-void savePlayerLevel(int level) {
-    FILE *f = fopen("profile.txt", "w");
-    if (!f) {
-        printf("Could not save player level.\n");
-        return;
+// Plays in raw mode until the exit or a quit key, returns true at the exit
+bool playRaw(Session *s, Renderer *r, Autosave *autosave, int fps, bool renderStats) {
+    LatencyStats *latency = (LatencyStats *)countedCalloc(1, sizeof(LatencyStats));
+    if (!latency) return false;
+    double frameMillis = 1000.0 / (fps > 0 ? fps : 60);
+    double lastFrame = -1e9, pending = -1;    // pending: when the oldest undrawn key came in
+    bool dirty = true, playing = true;
+    Overlay overlay = {NULL, false, NULL};
+    sayCapture = true;
+    rendererInvalidate(r);
+    while (playing && !sessionFinished(s)) {
+        double now = nowMillis();
+        if (dirty && now - lastFrame >= frameMillis) {
+            drawRawFrame(r, s, &overlay, latency, renderStats);
+            lastFrame = nowMillis();
+            if (pending >= 0) latencyAdd(latency, lastFrame - pending);
+            pending = -1;
+            dirty = false;
+        }
+        int timeout = dirty ? (int)(frameMillis - (now - lastFrame)) + 1 : -1;
+        struct pollfd in = {STDIN_FILENO, POLLIN, 0};
+        PROFILE_START(profile);
+        int ready = poll(&in, 1, timeout);
+        if (ready > 0) PROFILE_STOP(profile, PROF_INPUT);    // a timeout only paced frames
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) break;
+        if (ready == 0) continue;
+        char keys[64];
+        ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+        if (n <= 0) break;    // the terminal went away
+        if (pending < 0) pending = nowMillis();
+        for (ssize_t i = 0; i < n && playing && !sessionFinished(s); i++) {
+            char key = keys[i];
+            // arrow keys: ESC [ A/B/C/D
+            if (key == 0x1B && i + 2 < n && keys[i + 1] == '[' && keys[i + 2] >= 'A' && keys[i + 2] <= 'D') {
+                key = "wsda"[keys[i + 2] - 'A'];
+                i += 2;
+            }
+            KeyOutcome outcome = rawKey(s, key, r, &overlay, autosave);
+            if (outcome == KEY_PROMPTED) pending = nowMillis();
+            playing = outcome != KEY_QUIT;
+        }
+        dirty = true;
     }
-    fprintf(f, "%d\n", level);
-    fclose(f);
+    sayCapture = false;
+    printf("\n");
+    printMessages();
+    if (latency->frames > 0) {
+        printf("Key to screen: %ld frames, mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+               latency->frames, latency->sumMillis / latency->frames, latencyPercentile(latency, 0.5),
+               latencyPercentile(latency, 0.99), latency->maxMillis);
+    }
+    free(latency);
+    return sessionFinished(s);
 }
 
-void showSpeedrunMedal(int steps) {
-    printf("\n===== SPEEDRUN RESULT =====\n");
-    if (steps <= 40) {
-        printf("Medal: GOLD – You found a very efficient path through the maze!\n");
-    } else if (steps <= 80) {
-        printf("Medal: SILVER – Balanced between exploration and efficiency.\n");
-    } else if (steps <= 140) {
-        printf("Medal: BRONZE – You made it, with plenty of detours.\n");
-    } else {
-        printf("Medal: EXPLORER – You took your time and saw a lot of the maze.\n");
+// --- Game server ---
+// --serve PATH hosts any number of sessions on a Unix socket. Every worker thread runs its own
+// epoll loop over the connections it accepted and every connection owns its Session (grid,
+// player, NPCs, counters, random streams), so a move, an obstacle, a morph or a frame never
+// waits on another player. Sockets are non-blocking: replies queue in the connection until the
+// socket takes them, a connection with SERVER_OUT_LIMIT bytes unsent is not read until they
+// drain, and a burst of keys is played SERVER_KEY_BATCH at a time between other connections,
+// so one slow or flooding client only slows itself.
+//
+// Protocol, text both ways:
+//   client: PLAY <profile> <level> <seed> <ROWS>x<COLS>\n   (seed 0 = random, 0x0 = no frames)
+//           then one byte per key: w/a/s/d move, j jump, h quote, q ends the run;
+//           after the run another PLAY line may follow
+//   server: one reply per PLAY line and per key: the messages it caused, the frame (ROWS lines
+//           of COLS characters around the player) when asked for, then the status line
+//           "@ <play|done|quit|error> <steps> <par> <x> <y> <mood>\n"
+// Each profile has its own files in --profiles DIR: NAME.profile.txt (player level),
+// NAME.journal.txt (life lessons) and NAME.stats.bin (session_stats.bin records).
+#define SERVER_PROFILES "profiles"
+#define SERVER_NAME_LEN 32
+#define SERVER_LINE_LEN 128
+#define SERVER_IN_LEN 4096
+#define SERVER_OUT_LIMIT (256 * 1024)     // unsent bytes that pause reading a connection
+#define SERVER_LESSON_FLUSH (16 * 1024)   // journal bytes a connection holds before writing them
+#define SERVER_EVENTS 256
+#define SERVER_KEY_BATCH 64               // keys of one connection played before the others get a turn
+
+typedef struct ServerConn {
+    int fd;
+    struct ServerConn *prev, *next;   // the worker's open connections
+    uint32_t events;          // epoll interest currently set
+    bool eof;                 // the client sent everything it will send
+    bool playing;
+    bool frames;
+    Session session;
+    Renderer renderer;
+    char profile[SERVER_NAME_LEN + 1];
+    int baseLevel;
+    char line[SERVER_LINE_LEN];   // PLAY line read so far
+    size_t lineLen;
+    char in[SERVER_IN_LEN];       // keys read but not played yet
+    size_t inStart, inLen;
+    char *out;                    // replies not sent yet
+    size_t outLen, outSent, outCap;
+    char *lessons;                // journal lines not written yet
+    size_t lessonLen, lessonCap;
+} ServerConn;
+
+typedef struct {
+    const char *path;
+    const char *profiles;
+    int npcs;
+} ServerConfig;
+
+typedef struct {
+    const ServerConfig *cfg;
+    int listenFd, epfd;
+    pthread_t thread;
+    ServerConn *conns;
+    long connections, runs, finished, moves;
+} ServerWorker;
+
+volatile sig_atomic_t serverStop = 0;
+
+void serverSignal(int sig) {
+    (void)sig;
+    serverStop = 1;
+}
+
+// Appends to a growable byte buffer, false when out of memory
+bool bufferAppend(char **buf, size_t *len, size_t *cap, const char *bytes, size_t n) {
+    if (n == 0) return true;
+    if (*len + n > *cap) {
+        size_t bigger = *cap * 2 + n + 256;
+        char *grown = (char *)countedRealloc(*buf, bigger);
+        if (!grown) return false;
+        *buf = grown;
+        *cap = bigger;
     }
-    printf("===========================\n");
+    memcpy(*buf + *len, bytes, n);
+    *len += n;
+    return true;
+}
+
+void serverProfilePath(const ServerWorker *w, const ServerConn *c, const char *suffix, char *path, size_t size) {
+    snprintf(path, size, "%s/%s%s", w->cfg->profiles, c->profile, suffix);
+}
+
+// One write per batch: O_APPEND keeps lines of two connections on one profile from interleaving
+void serverWriteLessons(ServerWorker *w, ServerConn *c) {
+    if (c->lessonLen == 0) return;
+    char path[512];
+    serverProfilePath(w, c, ".journal.txt", path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0 || write(fd, c->lessons, c->lessonLen) != (ssize_t)c->lessonLen) {
+        printf("Could not write journal of profile %s.\n", c->profile);
+    }
+    if (fd >= 0) close(fd);
+    c->lessonLen = 0;
 }
 
+// Messages and lessons the last key produced, the frame, then the status line
+void serverReply(ServerConn *c, const char *state) {
+    bufferAppend(&c->out, &c->outLen, &c->outCap, sayBuffer, sayLen);
+    sayLen = 0;
+    bufferAppend(&c->lessons, &c->lessonLen, &c->lessonCap, lessonBuffer, lessonLen);
+    lessonLen = 0;
+    const Session *s = &c->session;
+    if (c->frames && c->playing) {
+        printMazeGeneric(&c->renderer, &s->grid, s->player.x, s->player.y, s->exitX, s->exitY);
+        bufferAppend(&c->out, &c->outLen, &c->outCap, c->renderer.out, c->renderer.outLen);
+    }
+    char status[96];
+    int n = snprintf(status, sizeof(status), "@ %s %d %d %d %d %d\n", state, s->steps, s->par, s->player.x,
+                     s->player.y, s->player.mood);
+    bufferAppend(&c->out, &c->outLen, &c->outCap, status, n);
+}
 
+// Ends the run; a finished one is scored and saved to the profile like a run in the terminal
+void serverEndRun(ServerWorker *w, ServerConn *c, bool finished) {
+    Session *s = &c->session;
+    if (finished) {
+        say("\nCongratulations! You reached the exit in %d steps (par %d).\n", s->steps, s->par);
+        int xp = showAchievementsAndComputeXP(s->steps, s->par, s->moodCounts, s->trapCount, s->puzzleCount,
+                                              s->bonusCount, s->philosophyUses);
+        int newLevel = levelAfterRun(c->baseLevel, xp);
+        say("Player level went from %d to %d.\n", c->baseLevel, newLevel);
+        char path[512];
+        serverProfilePath(w, c, ".profile.txt", path, sizeof(path));
+        savePlayerLevel(path, newLevel);
+        StatsRecord record = {s->seed, (int64_t)time(NULL), s->level, newLevel, s->steps, s->par, xp,
+                              {s->moodCounts[SAD], s->moodCounts[NEUTRAL], s->moodCounts[HAPPY]},
+                              s->trapCount, s->puzzleCount, s->bonusCount, s->philosophyUses};
+        serverProfilePath(w, c, ".stats.bin", path, sizeof(path));
+        statsAppend(path, &record);
+        w->finished++;
+    }
+    c->playing = false;
+    serverReply(c, finished ? "done" : "quit");
+    serverWriteLessons(w, c);
+    if (c->frames) rendererFree(&c->renderer);
+    sessionFree(s);
+    memset(s, 0, sizeof(*s));
+}
 
+bool serverProfileName(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > SERVER_NAME_LEN) return false;
+    for (size_t i = 0; i < len; i++) {
+        char ch = name[i];
+        if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' || ch == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
 
-int main() {
-   int baseLevel = loadPlayerLevel();
-printf("Saved player level (from previous runs): %d\n", baseLevel);
-
-int chosenLevel;
-printf("Choose level to play (1–50): ");
-scanf("%d", &chosenLevel);
-if (chosenLevel < 1) chosenLevel = 1;
-if (chosenLevel > 50) chosenLevel = 50;
-
-
-int size = levelToSize(chosenLevel);
-int rows = size, cols = size;
-int exitX = rows - 1, exitY = cols - 1;
-
-printf("Starting level %d -> maze size %d x %d\n", chosenLevel, rows, cols);
-
-
-    srand(time(NULL));
-    int moodCounts[3] = {0, 0, 0};   // SAD, NEUTRAL, HAPPY
-    int trapCount = 0;
-    int puzzleCount = 0;
-    int bonusCount = 0;
-    int philosophyUses = 0;
-    int steps = 0;
-
-
-    int **maze = allocate2DIntArray(rows, cols);
-    int **obstacles = allocate2DIntArray(rows, cols);
-    bool **visited = allocate2DBoolArray(rows, cols);
-    generateMaze(maze, rows, cols, exitX, exitY);
-    placeObstacles(maze, obstacles, rows, cols, exitX, exitY, chosenLevel);
-    int npcCount = 3;
-    NPC npcs[3];
-    initNPCs(npcs, npcCount, rows, cols, maze);
-
-    Player player = {0, 0, NEUTRAL};
-    visited[player.x][player.y] = true;
-    Mood oldMood = player.mood;
-    bool **preservePath = (bool **)malloc(rows * sizeof(bool *));
-for (int i = 0; i < rows; i++) {
-    preservePath[i] = (bool *)calloc(cols, sizeof(bool));
-}
-
-
-
-
-    // To track previous direction
-char move;
-char lastMove = 'd'; // default (right), update each move
-
-while (player.x != exitX || player.y != exitY) {
-    showRandomPhilosophySupport();
-    waitForEnter();
-    printMazeGeneric(maze, obstacles, rows, cols, player.x, player.y, exitX, exitY, visited, npcs, npcCount);
-    printPlayerStatus(player);
-    printf("\nMove (w/a/s/d), 'j' to jump, 'l' for journal, or 's' to save: ");
-    scanf(" %c", &move);
-
-    int newX = player.x;
-    int newY = player.y;
-    int jumpX = player.x;
-    int jumpY = player.y;
-
-    // Standard moves
-    if (move == 'w')      { newX--; lastMove = 'w'; }
-    else if (move == 's') { newX++; lastMove = 's'; }
-    else if (move == 'a') { newY--; lastMove = 'a'; }
-    else if (move == 'd') { newY++; lastMove = 'd'; }
-    // ----- JUMP FEATURE -----
-    else if (move == 'j') {
-        // set jumpX/jumpY two tiles ahead in lastMove direction
-        if (lastMove == 'w')      { jumpX -= 2; }
-        else if (lastMove == 's') { jumpX += 2; }
-        else if (lastMove == 'a') { jumpY -= 2; }
-        else if (lastMove == 'd') { jumpY += 2; }
-        // to check jumping rules
-        int midX = (player.x + jumpX) / 2;
-        int midY = (player.y + jumpY) / 2;
-        // will only allow jump over #, not over traps/puzzles/bonus
-        if (jumpX >= 0 && jumpX < rows && jumpY >= 0 && jumpY < cols &&
-            maze[midX][midY] == 0 && maze[jumpX][jumpY] == 1 &&
-            (obstacles[midX][midY] == NONE)) 
-        {
-            player.x = jumpX;
-            player.y = jumpY;
-            visited[player.x][player.y] = true;
-            steps++;
-            printf("You jumped over a wall!\n");
-            // might add a mood boost here, later, when? I don't know too
-            processObstacle(&player, obstacles[player.x][player.y], &trapCount, &puzzleCount, &bonusCount, rows, cols);
-    
-                oldMood = player.mood;
-                player.mood = generateMood();
-                if (oldMood != player.mood) {
-                    printf("\nThe maze feels different... mood shift is morphing the labyrinth!\n");
-                    morphMaze(maze, obstacles, rows, cols, 3, preservePath, player);
-                }
-                continue; // next loop, already applied move
-        }
-        // If blocked by letter obstacle or invalid, trigger mini-game or block
-        else if (jumpX >= 0 && jumpX < rows && jumpY >= 0 && jumpY < cols &&
-                 (obstacles[midX][midY] != NONE)) 
-        {
-            printf("Oops! You tried to jump a special tile. Solve this word puzzle to proceed!\n");
-            // (Call mini word game))
-            // (If failed, don't move, else allow)
+// "PLAY <profile> <level> <seed> <ROWS>x<COLS>": starts a new run on the connection
+void serverPlay(ServerWorker *w, ServerConn *c, const char *line) {
+    char profile[SERVER_NAME_LEN + 2];
+    int level, screenRows, screenCols;
+    unsigned long long seed;
+    if (sscanf(line, "PLAY %33s %d %llu %dx%d", profile, &level, &seed, &screenRows, &screenCols) != 5 ||
+        !serverProfileName(profile) || level < 1 || level > 50 || screenRows < 0 || screenCols < 0) {
+        say("Expected: PLAY <profile> <level 1-50> <seed> <ROWS>x<COLS>\n");
+        serverReply(c, "error");
+        return;
+    }
+    memcpy(c->profile, profile, strlen(profile) + 1);
+    char path[512];
+    serverProfilePath(w, c, ".profile.txt", path, sizeof(path));
+    c->baseLevel = loadPlayerLevel(path);
+    if (seed == 0) seed = (uint64_t)time(NULL) << 20 ^ (uint64_t)(nowMillis() * 1000.0) ^ (uint64_t)c->fd;
+
+    Session *s = &c->session;
+    int size = levelToSize(level);
+    GenConfig gen = {GEN_DFS, 1, NULL, 0};
+    c->frames = screenRows > 0 && screenCols > 0;
+    if (!sessionGenerate(s, level, size, size, &gen, seed, NULL) || !sessionPopulate(s, w->cfg->npcs) ||
+        (c->frames && (!rendererInit(&c->renderer, size, size, false) ||
+                       !rendererResize(&c->renderer, screenRows + RENDER_MESSAGE_LINES, screenCols)))) {
+        if (c->frames) rendererFree(&c->renderer);
+        sessionFree(s);
+        memset(s, 0, sizeof(*s));
+        say("Not enough memory for a level %d maze.\n", level);
+        serverReply(c, "error");
+        return;
+    }
+    if (c->frames) {
+        c->renderer.ansi = false;    // the client gets whole frames
+        c->renderer.outFd = -1;
+    }
+    c->playing = true;
+    w->runs++;
+    say("Profile %s (player level %d), level %d: %d x %d maze, seed %llu, par %d\n", c->profile, c->baseLevel,
+        level, size, size, (unsigned long long)seed, s->par);
+    serverReply(c, "play");
+}
+
+// Plays one byte of input: part of a PLAY line between runs, a key during one
+void serverFeed(ServerWorker *w, ServerConn *c, char ch) {
+    if (!c->playing) {
+        if (ch == '\r') return;
+        if (ch != '\n') {
+            if (c->lineLen < SERVER_LINE_LEN - 1) c->line[c->lineLen++] = ch;
+            return;
+        }
+        c->line[c->lineLen] = '\0';
+        c->lineLen = 0;
+        if (c->line[0]) serverPlay(w, c, c->line);
+        return;
+    }
+    if (ch == '\n' || ch == '\r' || ch == ' ') return;
+    Session *s = &c->session;
+    if (ch == 'q') {
+        serverEndRun(w, c, false);
+        return;
+    }
+    sessionStep(s, ch);
+    w->moves++;
+    if (ch == 'h') {
+        bool exercise;
+        const char *text = drawPhilosophy(&s->rng.ui, &exercise);
+        say("\n--- %s ---\n%s\n", exercise ? "Philosophical Exercise" : "Philosophical Quote", text);
+    }
+    if (sessionFinished(s)) serverEndRun(w, c, true);
+    else serverReply(c, "play");
+    if (c->lessonLen >= SERVER_LESSON_FLUSH) serverWriteLessons(w, c);
+}
+
+void serverClose(ServerWorker *w, ServerConn *c) {
+    if (c->playing) {
+        serverWriteLessons(w, c);
+        if (c->frames) rendererFree(&c->renderer);
+        sessionFree(&c->session);
+    }
+    if (c->prev) c->prev->next = c->next;
+    else w->conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->out);
+    free(c->lessons);
+    free(c);
+}
+
+// Sends what the socket takes now, false when the peer is gone
+bool serverSend(ServerConn *c) {
+    while (c->outSent < c->outLen) {
+        ssize_t n = send(c->fd, c->out + c->outSent, c->outLen - c->outSent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->outSent += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
             continue;
         } else {
-            printf("Invalid jump!\n");
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    c->outLen = c->outSent = 0;
+    return true;
+}
+
+// Plays up to SERVER_KEY_BATCH buffered keys, fewer if the unsent replies reach the limit
+void serverPlayBuffered(ServerWorker *w, ServerConn *c) {
+    for (int k = 0; k < SERVER_KEY_BATCH && c->inStart < c->inLen && c->outLen - c->outSent < SERVER_OUT_LIMIT; k++) {
+        serverFeed(w, c, c->in[c->inStart++]);
+    }
+    if (c->inStart == c->inLen) c->inStart = c->inLen = 0;
+}
+
+// Reads while there is room and nothing is held back, wants writes while replies are queued.
+// Keys left over from a batch also wait for EPOLLOUT, which comes back on the next epoll_wait.
+void serverArm(ServerWorker *w, ServerConn *c) {
+    size_t unsent = c->outLen - c->outSent;
+    uint32_t events = 0;
+    if (!c->eof && unsent < SERVER_OUT_LIMIT && c->inLen < SERVER_IN_LEN) events |= EPOLLIN | EPOLLRDHUP;
+    if (unsent > 0 || c->inStart < c->inLen) events |= EPOLLOUT;
+    if (events == c->events) return;
+    struct epoll_event ev = {events, {.ptr = c}};
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+// Handles one epoll event of a connection, false when it was closed. After the client shuts
+// its side, the keys it sent are still played and answered before the connection closes.
+bool serverEvent(ServerWorker *w, ServerConn *c, uint32_t events) {
+    if (c->inStart > 0) {
+        memmove(c->in, c->in + c->inStart, c->inLen - c->inStart);
+        c->inLen -= c->inStart;
+        c->inStart = 0;
+    }
+    if ((events & EPOLLIN) && !c->eof && c->inLen < SERVER_IN_LEN) {
+        ssize_t n = read(c->fd, c->in + c->inLen, SERVER_IN_LEN - c->inLen);
+        if (n > 0) c->inLen += (size_t)n;
+        else if (n == 0) c->eof = true;
+        else if (errno != EAGAIN && errno != EINTR) events |= EPOLLERR;
+    }
+    serverPlayBuffered(w, c);
+    bool open = !(events & (EPOLLERR | EPOLLHUP)) && serverSend(c);
+    if (!open || (c->eof && c->inLen == 0 && c->outLen == 0)) {
+        serverClose(w, c);
+        return false;
+    }
+    serverArm(w, c);
+    return true;
+}
+
+void serverAccept(ServerWorker *w) {
+    for (int i = 0; i < 64; i++) {
+        int fd = accept(w->listenFd, NULL, NULL);
+        if (fd < 0) return;    // EAGAIN: another worker took it or nothing is left
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ServerConn *c = (ServerConn *)countedCalloc(1, sizeof(ServerConn));
+        struct epoll_event ev = {EPOLLIN | EPOLLRDHUP, {.ptr = c}};
+        if (!c || epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(c);
+            close(fd);
             continue;
         }
+        c->fd = fd;
+        c->events = ev.events;
+        c->next = w->conns;
+        if (w->conns) w->conns->prev = c;
+        w->conns = c;
+        w->connections++;
     }
-    else if(move == 'l') {
-        showJournal();
-        continue;
-    }
-    else if(move =='s'){
-        saveRunSnapshot("run_snapshot.txt", maze, obstacles, rows, cols, player, exitX, exitY);
-        continue;
-    }
-    else if (move == 'h') { showRandomPhilosophySupport();
-        philosophyUses++;
-        continue; }
-    else { printf("Invalid input!\n"); continue; }
-
-    // Standard move processing continues here...
-    if (newX >= 0 && newX < rows && newY >= 0 && newY < cols && maze[newX][newY] == 1) {
-        player.x = newX;
-        player.y = newY;
-        visited[player.x][player.y] = true;
-        steps++;
-        processObstacle(&player, obstacles[player.x][player.y], &trapCount, &puzzleCount, &bonusCount, rows, cols);
-
-        checkNPCEncounter(&player, npcs, npcCount, steps, trapCount, puzzleCount, philosophyUses);
-        oldMood = player.mood;
-        player.mood = generateMood();
-        moodCounts[player.mood]++;
-        if (oldMood != player.mood) {
-            printf("\nThe maze feels different... mood shift is morphing the labyrinth!\n");
-            morphMaze(maze, obstacles, rows, cols, 3, preservePath, player);
+}
+
+void *serverWorker(void *arg) {
+    ServerWorker *w = (ServerWorker *)arg;
+    sayCapture = true;
+    lessonCapture = true;
+    struct epoll_event events[SERVER_EVENTS];
+    while (!serverStop) {
+        int n = epoll_wait(w->epfd, events, SERVER_EVENTS, 250);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) serverAccept(w);
+            else serverEvent(w, (ServerConn *)events[i].data.ptr, events[i].events);
+        }
+    }
+    return NULL;
+}
+
+// Raises the open file limit as far as allowed, every connection is a descriptor
+void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Serves until SIGINT or SIGTERM, then closes every connection (unfinished runs are not scored)
+bool serve(const ServerConfig *cfg, int threads) {
+    if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(cfg->path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long: %s\n", cfg->path);
+        return false;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cfg->path);
+    if (mkdir(cfg->profiles, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create profile directory %s.\n", cfg->profiles);
+        return false;
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(cfg->path);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 4096) != 0) {
+        printf("Could not listen on %s.\n", cfg->path);
+        if (listenFd >= 0) close(listenFd);
+        return false;
+    }
+    raiseFileLimit();
+    buildCellGlyphs();          // before the workers, who share it
+    serving = true;
+    struct sigaction sa = {0};
+    sa.sa_handler = serverSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    ServerWorker *workers = (ServerWorker *)countedCalloc(threads, sizeof(ServerWorker));
+    int started = 0;
+    for (int t = 0; workers && t < threads; t++) {
+        ServerWorker *w = &workers[t];
+        w->cfg = cfg;
+        w->listenFd = listenFd;
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        // EPOLLEXCLUSIVE wakes one worker per new connection instead of all of them
+        struct epoll_event ev = {EPOLLIN | EPOLLEXCLUSIVE, {.ptr = NULL}};
+        if (w->epfd < 0 || epoll_ctl(w->epfd, EPOLL_CTL_ADD, listenFd, &ev) != 0 ||
+            pthread_create(&w->thread, NULL, serverWorker, w) != 0) {
+            if (w->epfd >= 0) close(w->epfd);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        printf("Could not start the server workers.\n");
+        free(workers);
+        close(listenFd);
+        unlink(cfg->path);
+        return false;
+    }
+    printf("Serving on %s with %d workers, profiles in %s/ (Ctrl-C stops)\n", cfg->path, started, cfg->profiles);
+    fflush(stdout);
+
+    long connections = 0, runs = 0, finished = 0, moves = 0;
+    for (int t = 0; t < started; t++) {
+        ServerWorker *w = &workers[t];
+        pthread_join(w->thread, NULL);
+        while (w->conns) serverClose(w, w->conns);
+        close(w->epfd);
+        connections += w->connections;
+        runs += w->runs;
+        finished += w->finished;
+        moves += w->moves;
+    }
+    close(listenFd);
+    unlink(cfg->path);
+    printf("\nServed %ld connections, %ld runs (%ld finished), %ld keys.\n", connections, runs, finished, moves);
+    profileReport(0);    // every session served, the seed column has no single value
+    free(workers);
+    return true;
+}
+
+// --- Load generator ---
+// --loadgen PATH opens --clients connections to a server and has each play --moves random keys,
+// one at a time: a key is sent once the reply to the previous one arrived, and the time in
+// between is that move's latency. A client whose run ends starts another one.
+typedef struct {
+    int fd;
+    Rng rng;
+    int movesLeft;
+    double sentAt;            // < 0 while nothing is in flight
+    bool inPlay;              // the last request was a key (not a PLAY line)
+    bool lineStart, status;   // parsing: at the start of a line, inside the status line
+    char statusLine[96];
+    int statusLen;
+} LoadClient;
+
+typedef struct {
+    const char *path;
+    int clients, moves, level;
+    int screenRows, screenCols;
+    uint64_t seed;
+} LoadConfig;
+
+bool loadSend(LoadClient *c, const char *bytes, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(c->fd, bytes, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;    // a request is a few bytes, the socket always has room for it
+        bytes += n;
+        len -= (size_t)n;
+    }
+    c->sentAt = nowMillis();
+    return true;
+}
+
+bool loadPlay(LoadClient *c, const LoadConfig *cfg, int id) {
+    char line[SERVER_LINE_LEN];
+    int n = snprintf(line, sizeof(line), "PLAY load%d %d %llu %dx%d\n", id, cfg->level,
+                     (unsigned long long)rngNext(&c->rng) + 1, cfg->screenRows, cfg->screenCols);
+    c->inPlay = false;
+    return loadSend(c, line, (size_t)n);
+}
+
+bool loadgen(const LoadConfig *cfg) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cfg->path);
+    raiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+    LoadClient *clients = (LoadClient *)countedCalloc(cfg->clients, sizeof(LoadClient));
+    LatencyStats *latency = (LatencyStats *)countedCalloc(1, sizeof(LatencyStats));
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!clients || !latency || epfd < 0) {
+        printf("Not enough memory for %d clients.\n", cfg->clients);
+        free(clients);
+        free(latency);
+        if (epfd >= 0) close(epfd);
+        return false;
+    }
+    int open = 0;
+    long runs = 0, finished = 0, errors = 0, replyBytes = 0;
+    double start = nowMillis();
+    for (int i = 0; i < cfg->clients; i++) {
+        LoadClient *c = &clients[i];
+        c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            printf("Could not connect to %s (client %d).\n", cfg->path, i);
+            if (c->fd >= 0) close(c->fd);
+            c->fd = -1;
+            break;
+        }
+        fcntl(c->fd, F_SETFL, O_NONBLOCK);
+        rngSeed(&c->rng, cfg->seed, (uint64_t)i);
+        c->movesLeft = cfg->moves;
+        c->lineStart = true;
+        struct epoll_event ev = {EPOLLIN, {.u32 = (uint32_t)i}};
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        if (!loadPlay(c, cfg, i)) break;
+        runs++;
+        open++;
+    }
+    double connected = nowMillis();
+
+    struct epoll_event events[SERVER_EVENTS];
+    char buf[65536];
+    while (open > 0) {
+        int n = epoll_wait(epfd, events, SERVER_EVENTS, 5000);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            printf("The server stopped answering.\n");
+            break;
+        }
+        for (int e = 0; e < n; e++) {
+            int id = (int)events[e].data.u32;
+            LoadClient *c = &clients[id];
+            ssize_t got = read(c->fd, buf, sizeof(buf));
+            if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            bool alive = got > 0;
+            replyBytes += got > 0 ? got : 0;
+            // a reply ends with its status line, the only line that starts with '@'
+            for (ssize_t k = 0; alive && k < got; k++) {
+                char ch = buf[k];
+                if (c->lineStart && ch == '@') c->status = true;
+                c->lineStart = ch == '\n';
+                if (!c->status) continue;
+                if (ch != '\n') {
+                    if (c->statusLen < (int)sizeof(c->statusLine) - 1) c->statusLine[c->statusLen++] = ch;
+                    continue;
+                }
+                c->statusLine[c->statusLen] = '\0';
+                c->status = false;
+                c->statusLen = 0;
+                if (c->inPlay) latencyAdd(latency, nowMillis() - c->sentAt);
+                char state[8] = "";
+                sscanf(c->statusLine, "@ %7s", state);
+                if (strcmp(state, "error") == 0) {
+                    errors++;
+                    alive = false;
+                } else if (c->movesLeft == 0) {
+                    alive = false;
+                } else if (strcmp(state, "play") == 0) {
+                    char key = "wasdj"[rngBelow(&c->rng, 5)];
+                    c->movesLeft--;
+                    c->inPlay = true;
+                    alive = loadSend(c, &key, 1);
+                } else {
+                    if (strcmp(state, "done") == 0) finished++;
+                    runs++;
+                    alive = loadPlay(c, cfg, id);
+                }
+            }
+            if (!alive) {
+                if (c->movesLeft > 0 && got <= 0) errors++;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                c->fd = -1;
+                open--;
+            }
+        }
+    }
+    double seconds = (nowMillis() - connected) / 1000.0;
+    for (int i = 0; i < cfg->clients; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    close(epfd);
+    printf("%d clients connected in %.1f ms, level %d, frames %dx%d\n", cfg->clients, connected - start,
+           cfg->level, cfg->screenRows, cfg->screenCols);
+    printf("%ld moves in %.2f s: %.0f moves/s, %.1f MB of replies\n", latency->frames, seconds,
+           seconds > 0 ? latency->frames / seconds : 0.0, replyBytes / 1048576.0);
+    if (latency->frames > 0) {
+        printf("Move latency: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               latency->sumMillis / latency->frames, latencyPercentile(latency, 0.5),
+               latencyPercentile(latency, 0.99), latency->maxMillis);
+    }
+    printf("Runs started %ld, finished %ld, errors %ld\n", runs, finished, errors);
+    free(clients);
+    free(latency);
+    return errors == 0;
+}
+
+// Command line: --level N skips the level prompt, --size R[xC] overrides the maze size,
+// --gen-only just generates the maze, reports the stats and exits,
+// --gen tiled --threads N carves tiles in parallel, --seed N makes the whole run reproducible,
+// --stream FILE writes a maze row by row without holding it in memory,
+// --render-stats prints bytes written and render time under every frame,
+// --npcs N places N archetype NPCs instead of 3,
+// --keylog FILE records the run's keys there, --replay FILE plays recorded runs back headless,
+// --journal-flush N[,MS] sets how often the journal reaches the file, --journal-nosync skips the fsync at the end,
+// --journal-rotate MB starts a new journal segment past MB, --journal-view prints part of the journal and exits,
+// --resume FILE continues a run saved with 'S',
+// --autosave N saves a delta every N moves (0 = off), --autosave-morph also after every morph,
+// --recover continues from the autosave after a crash,
+// --stats prints steps per level and the XP distribution of every finished run and exits,
+// --simulate RUNS plays RUNS bot sessions per level and bot (--levels A-B, --bots, --rules, --sim-keys),
+// --fps N caps the raw-mode redraws, --line-input keeps the Enter-per-move loop on a terminal,
+// --minimap shows the whole maze in blocks beside the view, --full-maze prints the whole maze every frame,
+// --campaign goes straight on to the next, bigger level after each exit,
+// --serve PATH hosts sessions on a Unix socket (--profiles DIR, --threads N),
+// --loadgen PATH plays --clients N connections of --moves N keys against it (--level, --screen RxC)
+typedef struct {
+    int level;        // 0 = ask on stdin
+    int rows, cols;   // 0 = take size from level
+    bool genOnly;
+    GenConfig gen;
+    bool hasSeed;
+    uint64_t seed;
+    const char *streamFile;
+    StreamFormat streamFormat;
+    bool renderStats;
+    int npcs;
+    const char *keyLogFile;
+    const char *replayFile;
+    JournalConfig journal;
+    const char *journalView;
+    const char *resumeFile;
+    AutosaveConfig autosave;
+    bool recover;
+    bool stats;
+    long simulate;    // runs per level and bot, 0 = play
+    int firstLevel, lastLevel;
+    const char *bots;
+    const char *rules;
+    int simKeys;
+    int fps;
+    bool lineInput;
+    bool minimap;
+    bool fullMaze;
+    bool campaign;
+    const char *servePath;
+    const char *profiles;
+    const char *loadgenPath;
+    int clients, moves;
+    int screenRows, screenCols;
+} Options;
+
+bool parseOptions(int argc, char **argv, Options *opt) {
+    memset(opt, 0, sizeof(*opt));
+    opt->npcs = 3;
+    opt->keyLogFile = KEYLOG_FILE;
+    opt->journal = (JournalConfig){32, 250, true, 64ll << 20};
+    opt->autosave = (AutosaveConfig){10, false};
+    opt->bots = "random,wall,optimal";
+    opt->simKeys = 20;
+    opt->fps = 60;
+    opt->profiles = SERVER_PROFILES;
+    opt->clients = 100;
+    opt->moves = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            opt->level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%dx%d", &opt->rows, &opt->cols) != 2) opt->cols = opt->rows;
+            if (opt->rows < 3 || opt->cols < 3) {
+                printf("Maze size must be at least 3x3.\n");
+                return false;
+            }
+            // the carver walks even cells from (0,0), odd sizes keep the exit on that lattice
+            if (opt->rows % 2 == 0) opt->rows++;
+            if (opt->cols % 2 == 0) opt->cols++;
+        } else if (strcmp(argv[i], "--gen-only") == 0) {
+            opt->genOnly = true;
+        } else if (strcmp(argv[i], "--gen") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "dfs") == 0) opt->gen.mode = GEN_DFS;
+            else if (strcmp(argv[i], "tiled") == 0) opt->gen.mode = GEN_TILED;
+            else {
+                printf("Unknown generator: %s (use dfs or tiled)\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt->gen.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opt->hasSeed = true;
+            opt->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--npcs") == 0 && i + 1 < argc) {
+            opt->npcs = atoi(argv[++i]);
+            if (opt->npcs < 0) opt->npcs = 0;
+        } else if (strcmp(argv[i], "--journal-flush") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%d,%d", &opt->journal.flushEvery, &opt->journal.flushMillis) < 1) {
+                printf("Bad --journal-flush: %s (use ENTRIES[,MS])\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--journal-rotate") == 0 && i + 1 < argc) {
+            opt->journal.rotateBytes = atoll(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--journal-view") == 0 && i + 1 < argc) {
+            opt->journalView = argv[++i];
+        } else if (strcmp(argv[i], "--journal-nosync") == 0) {
+            opt->journal.syncOnClose = false;
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            opt->resumeFile = argv[++i];
+        } else if (strcmp(argv[i], "--autosave") == 0 && i + 1 < argc) {
+            opt->autosave.steps = atoi(argv[++i]);
+            if (opt->autosave.steps < 0) opt->autosave.steps = 0;
+        } else if (strcmp(argv[i], "--autosave-morph") == 0) {
+            opt->autosave.onMorph = true;
+        } else if (strcmp(argv[i], "--recover") == 0) {
+            opt->recover = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            opt->stats = true;
+        } else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            opt->simulate = atol(argv[++i]);
+            if (opt->simulate < 1) {
+                printf("--simulate needs at least 1 run.\n");
+                return false;
+            }
+        } else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%d-%d", &opt->firstLevel, &opt->lastLevel) != 2 || opt->firstLevel < 1 ||
+                opt->lastLevel > 50 || opt->firstLevel > opt->lastLevel) {
+                printf("Bad --levels: %s (use FIRST-LAST within 1-50)\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            opt->bots = argv[++i];
+        } else if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            opt->rules = argv[++i];
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            opt->fps = atoi(argv[++i]);
+            if (opt->fps < 1) opt->fps = 1;
+        } else if (strcmp(argv[i], "--line-input") == 0) {
+            opt->lineInput = true;
+        } else if (strcmp(argv[i], "--minimap") == 0) {
+            opt->minimap = true;
+        } else if (strcmp(argv[i], "--full-maze") == 0) {
+            opt->fullMaze = true;
+        } else if (strcmp(argv[i], "--campaign") == 0) {
+            opt->campaign = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            opt->servePath = argv[++i];
+        } else if (strcmp(argv[i], "--profiles") == 0 && i + 1 < argc) {
+            opt->profiles = argv[++i];
+        } else if (strcmp(argv[i], "--loadgen") == 0 && i + 1 < argc) {
+            opt->loadgenPath = argv[++i];
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            opt->clients = atoi(argv[++i]);
+            if (opt->clients < 1) opt->clients = 1;
+        } else if (strcmp(argv[i], "--moves") == 0 && i + 1 < argc) {
+            opt->moves = atoi(argv[++i]);
+            if (opt->moves < 1) opt->moves = 1;
+        } else if (strcmp(argv[i], "--screen") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &opt->screenRows, &opt->screenCols) != 2 || opt->screenRows < 0 ||
+                opt->screenCols < 0) {
+                printf("Expected --screen ROWSxCOLS, e.g. 40x120 (0x0 = no frames)\n");
+                return false;
+            }
+        } else if (strcmp(argv[i], "--sim-keys") == 0 && i + 1 < argc) {
+            opt->simKeys = atoi(argv[++i]);
+            if (opt->simKeys < 1) opt->simKeys = 1;
+        } else if (strcmp(argv[i], "--keylog") == 0 && i + 1 < argc) {
+            opt->keyLogFile = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            opt->replayFile = argv[++i];
+        } else if (strcmp(argv[i], "--render-stats") == 0) {
+            opt->renderStats = true;
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            opt->streamFile = argv[++i];
+        } else if (strcmp(argv[i], "--stream-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "text") == 0) opt->streamFormat = STREAM_TEXT;
+            else if (strcmp(argv[i], "bin") == 0) opt->streamFormat = STREAM_BINARY;
+            else {
+                printf("Unknown stream format: %s (use text or bin)\n", argv[i]);
+                return false;
+            }
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            printf("Usage: %s [--level N] [--size ROWSxCOLS] [--gen-only] [--gen dfs|tiled] [--threads N] [--seed N]\n"
+                   "       [--stream FILE [--stream-format text|bin]] [--render-stats] [--npcs N]\n"
+                   "       [--keylog FILE] [--replay FILE] [--journal-flush ENTRIES[,MS]] [--journal-nosync]\n"
+                   "       [--journal-rotate MB] [--journal-view last:N|session:N|page:N] [--resume FILE]\n"
+                   "       [--autosave N] [--autosave-morph] [--recover] [--stats [--threads N]]\n"
+                   "       [--simulate RUNS [--levels A-B] [--bots random,wall,optimal] [--rules NAME=N,...] [--sim-keys N]]\n"
+                   "       [--fps N] [--line-input] [--minimap] [--full-maze]\n"
+                   "       [--serve PATH [--profiles DIR] [--threads N]]\n"
+                   "       [--loadgen PATH [--clients N] [--moves N] [--level N] [--screen ROWSxCOLS]]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Asks for the level (unless --level), seeds and carves the maze and populates it.
+// Returns 1 to play, 0 when the options only asked for the maze (--gen-only, --stream),
+// -1 on failure.
+int newSession(Session *session, const Options *opt, Arena *arena) {
+    int chosenLevel = opt->level;
+    if (chosenLevel == 0 && !opt->genOnly && !opt->streamFile) {
+        printf("Choose level to play (1–50): ");
+        scanf("%d", &chosenLevel);
+    }
+    if (chosenLevel < 1) chosenLevel = 1;
+    if (chosenLevel > 50) chosenLevel = 50;
+
+    int size = levelToSize(chosenLevel);
+    int rows = size, cols = size;
+    if (opt->rows > 0) { rows = opt->rows; cols = opt->cols; }
+    printf("Starting level %d -> maze size %d x %d\n", chosenLevel, rows, cols);
+
+    // every random decision of the run comes from this seed, print it so a run can be replayed
+    uint64_t seed = opt->hasSeed ? opt->seed : (uint64_t)time(NULL) << 20 ^ (uint64_t)(nowMillis() * 1000.0);
+    printf("Seed: %llu (replay with --seed %llu)\n", (unsigned long long)seed, (unsigned long long)seed);
+    if (opt->streamFile) {
+        RngStreams rng;
+        rngStreamsSeed(&rng, seed);
+        return streamMaze(opt->streamFile, rows, cols, chosenLevel, opt->streamFormat, &rng) ? 0 : -1;
+    }
+    GenStats genStats;
+    if (arena && !arenaReset(arena, sessionArenaBytes(rows, cols, opt->npcs))) {
+        printf("Not enough memory for a %d x %d maze.\n", rows, cols);
+        return -1;
+    }
+    if (!sessionGenerateIn(session, arena, chosenLevel, rows, cols, &opt->gen, seed, &genStats)) {
+        printf("Not enough memory for a %d x %d maze.\n", rows, cols);
+        sessionFree(session);
+        return -1;
+    }
+    printf("Maze generated in %.2f ms (peak memory %.1f KB, DFS depth %d)\n",
+           genStats.millis, genStats.peakBytes / 1024.0, genStats.maxDepth);
+    if (opt->genOnly) {
+        sessionFree(session);
+        return 0;
+    }
+    if (!sessionPopulate(session, opt->npcs)) {
+        printf("Not enough memory for the cell, route and NPC indexes.\n");
+        sessionFree(session);
+        return -1;
+    }
+    printf("Par: %d steps (solved in %.0f us)\n", session->par, session->solver.lastMicros);
+    return 1;
+}
+
+// The Enter-per-move loop for piped input and --line-input, false when the input closes first
+bool playLines(Session *s, Renderer *r, Autosave *autosave, bool renderStats) {
+    char move;
+    while (!sessionFinished(s)) {
+        showRandomPhilosophySupport(&s->rng.ui);
+        // one input-wait sample per move, from the Enter prompt to the key, as in the single-key loop
+        PROFILE_START(wait);
+        waitForEnter();
+        PROFILE_START(frame);
+        printMazeGeneric(r, &s->grid, s->player.x, s->player.y, s->exitX, s->exitY);
+        PROFILE_SKIP(wait, frame);    // timed as a frame
+        if (renderStats) printf("[frame %ld: %zu bytes in %.0f us]\n", r->frames, r->lastBytes, r->lastMicros);
+        printPlayerStatus(s->player);
+        printf("\nMove (w/a/s/d), 'j' to jump, 'h' for a quote, 'l' for journal, 'S' to save, 'm' for the minimap, "
+               "'P' for the profile: ");
+        if (scanf(" %c", &move) != 1) {
+            printf("\nInput closed, leaving the maze.\n");
+            return false;
+        }
+        PROFILE_STOP(wait, PROF_INPUT);
+        if (move != 'm' && move != 'P') keyLogKey(move);    // the minimap and the profile are not part of the run
+
+        if (move == 'l') {
+            showJournal();
+            rendererInvalidate(r);
+        } else if (move == 'm') {
+            rendererSetMinimap(r, &s->grid, !r->minimap);
+        } else if (move == 'P') {
+            char table[2048];
+            profileFormat(table, sizeof(table));
+            printf("\n%s", table);
+        } else if (move == 'S') {
+            saveRun(s);
+        } else {
+            StepResult result = sessionStep(s, move);
+            if (result == STEP_MET_NPC) rendererInvalidate(r);
+            if (result == STEP_MOVED || result == STEP_MET_NPC) autosaveAfterMove(autosave, s);
         }
-    } else {
-        printf("Invalid move!\n");
     }
+    return true;
 }
 
-    printMazeGeneric(maze, obstacles, rows, cols, player.x, player.y, exitX, exitY, visited, npcs, npcCount);
-    printPlayerStatus(player);
+// Analytics, medal and XP of a run that reached the exit; saves the new player level and the
+// stats record and returns the new level
+int reportRun(Session *s, Renderer *r, int baseLevel) {
+    int steps = s->steps, par = s->par;
+    int *moodCounts = s->moodCounts;
+    int trapCount = s->trapCount, puzzleCount = s->puzzleCount;
+    int bonusCount = s->bonusCount, philosophyUses = s->philosophyUses;
+
+    rendererInvalidate(r);
+    printMazeGeneric(r, &s->grid, s->player.x, s->player.y, s->exitX, s->exitY);
+    printPlayerStatus(s->player);
     printf("\nCongratulations! You reached the exit.\n");
 
     printf("\n===== SESSION ANALYTICS =====\n");
-    printf("Total steps taken: %d\n", steps);
+    printf("Total steps taken: %d (par %d)\n", steps, par);
     printf("Mood counts:\n");
     printf("  Sad:     %d\n", moodCounts[SAD]);
     printf("  Neutral: %d\n", moodCounts[NEUTRAL]);
@@ -787,54 +6702,192 @@ while (player.x != exitX || player.y != exitY) {
     printf("  Puzzles: %d\n", puzzleCount);
     printf("  Bonuses: %d\n", bonusCount);
     printf("Philosophy uses (quotes/exercises): %d\n", philosophyUses);
+    if (r->frames > 0) {
+        printf("Frames drawn: %ld (avg %.0f bytes, %.1f us per frame)\n", r->frames,
+               (double)r->totalBytes / r->frames, r->totalMicros / r->frames);
+    }
 
-// simple ASCII bar for mood
-int totalMoods = moodCounts[SAD] + moodCounts[NEUTRAL] + moodCounts[HAPPY];
-if (totalMoods > 0) {
-    printf("\nMood distribution (ASCII):\n");
-    printf("Sad:     ");
-    for (int i = 0; i < moodCounts[SAD]; i++) printf("*");
-    printf("\nNeutral: ");
-    for (int i = 0; i < moodCounts[NEUTRAL]; i++) printf("*");
-    printf("\nHappy:   ");
-    for (int i = 0; i < moodCounts[HAPPY]; i++) printf("*");
-    printf("\n");
-}
-printf("===== END OF SESSION =====\n");
+    // simple ASCII bar for mood
+    int totalMoods = moodCounts[SAD] + moodCounts[NEUTRAL] + moodCounts[HAPPY];
+    if (totalMoods > 0) {
+        printf("\nMood distribution (ASCII):\n");
+        printf("Sad:     ");
+        for (int i = 0; i < moodCounts[SAD]; i++) printf("*");
+        printf("\nNeutral: ");
+        for (int i = 0; i < moodCounts[NEUTRAL]; i++) printf("*");
+        printf("\nHappy:   ");
+        for (int i = 0; i < moodCounts[HAPPY]; i++) printf("*");
+        printf("\n");
+    }
+    printf("===== END OF SESSION =====\n");
+
+    showSpeedrunMedal(steps, par);
 
-showSpeedrunMedal(steps);
+    int earnedXP = showAchievementsAndComputeXP(steps, par, moodCounts,
+                                                trapCount, puzzleCount, bonusCount,
+                                                philosophyUses);
+    printf("You earned %d XP this session!\n", earnedXP);
 
-int earnedXP = showAchievementsAndComputeXP(steps, moodCounts,
-                                            trapCount, puzzleCount, bonusCount,
-                                            philosophyUses);
-printf("You earned %d XP this session!\n", earnedXP);
+    int newLevel = levelAfterRun(baseLevel, earnedXP);
 
-int newLevel = baseLevel;
-if (earnedXP >= 60) newLevel += 2;
-else if (earnedXP >= 30) newLevel += 1;
-// cap
-if (newLevel > 50) newLevel = 50;
+    printf("Player level went from %d to %d.\n", baseLevel, newLevel);
+    savePlayerLevel(PROFILE_FILE, newLevel);
 
-printf("Player level went from %d to %d.\n", baseLevel, newLevel);
-savePlayerLevel(newLevel);
+    StatsRecord record = {s->seed, (int64_t)time(NULL), s->level, newLevel, steps, par, earnedXP,
+                          {moodCounts[SAD], moodCounts[NEUTRAL], moodCounts[HAPPY]},
+                          trapCount, puzzleCount, bonusCount, philosophyUses};
+    statsAppend(STATS_FILE, &record);
+    return newLevel;
+}
 
+// --campaign: the level after the one just cleared, two cells bigger each way (levelToSize, or
+// the --size maze grown the same way), with its own seed drawn from the last one. Every buffer
+// comes from the arena, so nothing is freed and nothing new is allocated once the arena is big enough.
+bool campaignNext(Session *s, Arena *arena, const Options *opt) {
+    int level = s->level + 1;
+    int rows = opt->rows > 0 ? s->grid.rows + 2 : levelToSize(level);
+    int cols = opt->rows > 0 ? s->grid.cols + 2 : levelToSize(level);
+    uint64_t seed = s->seed + 0x9E3779B97F4A7C15ull;
+    double start = nowMillis();
+    unsigned long allocs = allocCalls;
+    sessionFree(s);    // only a resumed or recovered first level lives on the heap
+    if (!arenaReset(arena, sessionArenaBytes(rows, cols, opt->npcs)) ||
+        !sessionGenerateIn(s, arena, level, rows, cols, &opt->gen, seed, NULL) || !sessionPopulate(s, opt->npcs)) {
+        printf("Not enough memory for a %d x %d maze.\n", rows, cols);
+        return false;
+    }
+    printf("\nStarting level %d -> maze size %d x %d, seed %llu, par %d (ready in %.2f ms, %lu allocations)\n",
+           level, rows, cols, (unsigned long long)seed, s->par, nowMillis() - start, allocCalls - allocs);
+    return true;
+}
 
+int main(int argc, char **argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, &opt)) return 1;
+    if (opt.replayFile) return replayKeyLog(opt.replayFile) == 0 ? 0 : 1;
+    if (opt.journalView) return printJournalView(opt.journalView) ? 0 : 1;
+    if (opt.stats) return printStats(STATS_FILE, opt.gen.threads) ? 0 : 1;
+    if (opt.servePath) {
+        ServerConfig server = {opt.servePath, opt.profiles, opt.npcs};
+        return serve(&server, opt.gen.threads) ? 0 : 1;
+    }
+    if (opt.loadgenPath) {
+        LoadConfig load = {opt.loadgenPath, opt.clients, opt.moves, opt.level ? opt.level : 10,
+                           opt.screenRows, opt.screenCols, opt.hasSeed ? opt.seed : (uint64_t)time(NULL)};
+        return loadgen(&load) ? 0 : 1;
+    }
+    // other rules would make runs that no key log can replay, so they stay in the simulator
+    if (opt.rules && !opt.simulate) {
+        printf("--rules only applies to --simulate.\n");
+        return 1;
+    }
+    if (opt.simulate) {
+        SimConfig sim = {0};
+        sim.firstLevel = opt.firstLevel ? opt.firstLevel : opt.level ? opt.level : 1;
+        sim.lastLevel = opt.firstLevel ? opt.lastLevel : opt.level ? opt.level : 50;
+        if (sim.firstLevel < 1 || sim.lastLevel > 50) {
+            printf("Levels go from 1 to 50.\n");
+            return 1;
+        }
+        sim.runs = opt.simulate;
+        sim.seed = opt.hasSeed ? opt.seed : (uint64_t)time(NULL);
+        sim.npcs = opt.npcs;
+        sim.keyBudget = opt.simKeys;
+        if (!parseBots(opt.bots, &sim) || (opt.rules && !parseRules(opt.rules))) return 1;
+        printf("Simulation seed: %llu\n", (unsigned long long)sim.seed);
+        return simulate(&sim, opt.gen.threads) ? 0 : 1;
+    }
 
-saveSessionSummary("session_stats.txt",
-                   steps, moodCounts,
-                   trapCount, puzzleCount, bonusCount,
-                   philosophyUses);
+    int baseLevel = loadPlayerLevel(PROFILE_FILE);
+    printf("Saved player level (from previous runs): %d\n", baseLevel);
 
-askEndOfSessionReflection();
+    // the session owns the maze and every counter, sessionStep plays one key on it;
+    // a campaign takes each level's buffers from the arena
+    Session session;
+    Arena arena = {0};
+    if (opt.recover) {
+        double start = nowMillis();
+        long applied = autosaveRecover(&session);
+        if (applied < 0) {
+            printf("Could not recover: no usable %s.\n", autosaveBase);
+            return 1;
+        }
+        printf("Recovered level %d (%d x %d) at step %d from %s + %ld deltas in %.2f ms\n", session.level,
+               session.grid.rows, session.grid.cols, session.steps, autosaveBase, applied, nowMillis() - start);
+    } else if (opt.resumeFile) {
+        double start = nowMillis();
+        if (!loadSnapshot(opt.resumeFile, &session)) return 1;
+        printf("Resumed level %d (%d x %d) at step %d from %s in %.2f ms\n", session.level,
+               session.grid.rows, session.grid.cols, session.steps, opt.resumeFile, nowMillis() - start);
+    } else {
+        if (autosaveExists() && !opt.genOnly && !opt.streamFile) {
+            printf("An unfinished run was autosaved, continue it with --recover (a new run replaces it).\n");
+        }
+        int started = newSession(&session, &opt, opt.campaign ? &arena : NULL);
+        if (started <= 0) {
+            arenaFree(&arena);
+            return started < 0 ? 1 : 0;
+        }
+    }
+    Renderer renderer;
+    if (!rendererInit(&renderer, session.grid.rows, session.grid.cols, opt.fullMaze)) {
+        printf("Not enough memory for the screen buffer.\n");
+        sessionFree(&session);
+        arenaFree(&arena);
+        return 1;
+    }
+    if (opt.minimap && !rendererSetMinimap(&renderer, &session.grid, true)) {
+        printf("Not enough memory for the minimap, playing without it.\n");
+    }
+    if (!journalOpen(&journal, journalFile, opt.journal)) {
+        printf("Could not start the journal writer, writing entries one at a time.\n");
+    }
 
+    // single keys straight from the terminal, unless input is piped or --line-input
+    if (!opt.lineInput && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) {
+        if (opt.level == 0 && !opt.resumeFile && !opt.recover) skipInputLine();   // after the level prompt
+        rawInput = terminalRaw();
+        if (rawInput) atexit(terminalRestore);
+    }
+    // a resumed or recovered run has no start that a seed and keys could rebuild, so it is not recorded
+    bool recorded = !opt.resumeFile && !opt.recover;
+    bool reachedExit;
+    for (;;) {
+        if (recorded) keyLogOpen(opt.keyLogFile, &session, &opt.gen);
+        Autosave autosave = {0};
+        if ((opt.autosave.steps > 0 || opt.autosave.onMorph) && !autosaveStart(&autosave, &session, opt.autosave)) {
+            printf("Autosave is off for this run.\n");
+        }
+        if (rawInput) reachedExit = playRaw(&session, &renderer, &autosave, opt.fps, opt.renderStats);
+        else reachedExit = playLines(&session, &renderer, &autosave, opt.renderStats);
+        autosaveStop(&autosave, &session, reachedExit);
+        if (!reachedExit) break;
 
+        baseLevel = reportRun(&session, &renderer, baseLevel);
+        if (!opt.campaign || session.level >= 50) break;
+        // each level is its own run in the key log, so replay checks them one by one
+        keyLogClose(&session);
+        if (!campaignNext(&session, &arena, &opt)) {
+            reachedExit = false;
+            break;
+        }
+        recorded = true;
+        if (!rendererSetMaze(&renderer, &session.grid)) printf("Not enough memory for the screen buffer.\n");
+    }
+    terminalRestore();
+    if (reachedExit) {
+        if (opt.campaign) printf("\nCampaign complete: every level up to %d cleared.\n", session.level);
+        askEndOfSessionReflection();
+    }
+    keyLogClose(&session);
+    journalClose(&journal);
+    profileReport(session.seed);
 
     // Free all dynamic memory
-    free2DIntArray(maze, rows);
-    free2DIntArray(obstacles, rows);
-    free2DBoolArray(visited, rows);
-    free2DBoolArray(preservePath, rows);
+    rendererFree(&renderer);
+    sessionFree(&session);
+    arenaFree(&arena);
     return 0;
 }
 
-
+#endif // PSYMAZE_BENCH
@@ -0,0 +1,73 @@
+// PsyMaze batched environments for agent training.
+//
+// Build the library object and link it with your trainer:
+//     gcc -O2 -pthread -DPSYMAZE_LIB -c initial.c -o psymaze_env.o
+//
+// One PsyEnv steps count independent mazes of the same level at once, on several threads,
+// with no output at all: messages, journal entries and prompts are off. Each maze plays by the
+// game's rules (moves, jumps over walls, traps, puzzles, bonuses, power-ups, mood rolls and the
+// morphs they trigger), without NPCs, which only talk. Every call fills one slot per maze:
+//     obs      PSY_ENV_OBS bytes: the PSY_ENV_VIEW x PSY_ENV_VIEW cells around the player, row
+//              by row (bit 0 open, bits 1-3 obstacle 1 trap 2 puzzle 3 bonus 4 power-up,
+//              bit 4 visited, 0 outside the maze), then the player's mood (0 sad, 1 neutral, 2 happy)
+//     rewards  see PsyEnvRewards
+//     dones    0 playing, PSY_ENV_EXIT reached the exit, PSY_ENV_TRUNCATED ran out of maxSteps
+// With autoReset a finished maze starts a new episode in the same step: its done flag marks
+// the end of the old episode and obs already shows the new one.
+#ifndef PSYMAZE_ENV_H
+#define PSYMAZE_ENV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PSY_ENV_VIEW 9
+#define PSY_ENV_OBS (PSY_ENV_VIEW * PSY_ENV_VIEW + 1)
+
+// Actions, the game keys w, s, a, d and j (jump over a wall in the last direction moved)
+enum { PSY_ACT_UP, PSY_ACT_DOWN, PSY_ACT_LEFT, PSY_ACT_RIGHT, PSY_ACT_JUMP, PSY_ACTIONS };
+
+enum { PSY_ENV_PLAYING, PSY_ENV_EXIT, PSY_ENV_TRUNCATED };
+
+typedef struct {
+    float step;           // every action
+    float invalid;        // moving into a wall or jumping where the game refuses it
+    float trapHit;        // stepping on a trap while not happy (the mood drops to sad)
+    float trapAvoided;    // stepping on a trap while happy
+    float puzzle, bonus, powerup;
+    float exit;
+} PsyEnvRewards;
+
+typedef struct {
+    int count;            // number of mazes
+    int level;            // 1-50, sets the maze size and the obstacle density
+    int threads;          // 0 = every core
+    int maxSteps;         // actions before an episode is truncated, 0 = never
+    bool autoReset;
+    uint64_t seed;        // the same seed, count and actions give the same episodes on any thread count
+    PsyEnvRewards rewards;
+} PsyEnvConfig;
+
+// Read-only views of the per-maze state, one entry per maze
+typedef struct {
+    const int32_t *x, *y;
+    const uint8_t *mood;
+    const int32_t *steps;                     // moves made this episode, refused actions not counted
+    const int32_t *trapCount, *puzzleCount, *bonusCount;
+    const uint32_t *episodes;                 // episodes started so far
+    const unsigned char *cells;               // every maze, rows x cols bytes each, back to back
+    int rows, cols;
+} PsyEnvState;
+
+typedef struct PsyEnv PsyEnv;
+
+PsyEnvRewards psyEnvDefaultRewards(void);
+// NULL when out of memory or the config is invalid
+PsyEnv *psyEnvCreate(const PsyEnvConfig *cfg);
+void psyEnvFree(PsyEnv *env);
+// Starts a new episode in every maze and writes count * PSY_ENV_OBS bytes of observations
+void psyEnvReset(PsyEnv *env, uint8_t *obs);
+// actions: count entries; obs: count * PSY_ENV_OBS bytes; rewards and dones: count entries
+void psyEnvStep(PsyEnv *env, const uint8_t *actions, uint8_t *obs, float *rewards, uint8_t *dones);
+PsyEnvState psyEnvState(const PsyEnv *env);
+
+#endif